@@ -0,0 +1,157 @@
+/*******************************************************************
+    Search for tweets, checking more often while tweets are coming in
+    and less often when it's quiet. The ESP32 light sleeps in between.
+
+    Parts:
+    ESP32 Dev Board
+       Aliexpress: * - https://s.click.aliexpress.com/e/_dSi824B
+       Amazon: * - https://amzn.to/3gArkAY
+
+ *  * = Affilate
+
+    If you find what I do useful and would like to support me,
+    please consider becoming a sponsor on Github
+    https://github.com/sponsors/witnessmenow/
+
+
+    Written by Brian Lough
+    YouTube: https://www.youtube.com/brianlough
+    Tindie: https://www.tindie.com/stores/brianlough/
+    Twitter: https://twitter.com/witnessmenow
+
+ *******************************************************************/
+
+// ----------------------------
+// Standard Libraries
+// ----------------------------
+
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+
+#include "time.h"
+
+// ----------------------------
+// Required Libraries
+// ----------------------------
+
+#include <TweESP32.h>          // Install from Github - https://github.com/witnessmenow/TweESP32
+#include <TweetPoller.h>       // included with above
+#include <TwitterServerCert.h> // included with above
+
+// ----------------------------
+// Dependant Libraries
+// ----------------------------
+
+#include <UrlEncode.h> //Install from library manager
+
+#include <ArduinoJson.h> //Install from library manager
+
+// ----------------------------
+// ------- Replace the following! ------
+// ----------------------------
+
+char ssid[] = "SSID";         // your network SSID (name)
+char password[] = "Password"; // your network key
+
+// Create a project and an app here to get keys https://developer.twitter.com/en/portal/dashboard
+
+const char *bearerToken = "QUACK";
+
+// ----------------------------
+
+// For HTTPS requests
+WiFiClientSecure client;
+
+TweESP32 twitter(client, bearerToken);
+
+// Polls at most every 30 seconds, and at least every 15 minutes
+TweetPoller poller(twitter, 30000, 900000);
+
+void setup()
+{
+
+    Serial.begin(115200);
+
+    // Connect to the WiFI
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(ssid, password);
+    Serial.println("");
+
+    // Wait for connection
+    while (WiFi.status() != WL_CONNECTED)
+    {
+        delay(500);
+        Serial.print(".");
+    }
+    Serial.println("");
+    Serial.print("Connected to ");
+    Serial.println(ssid);
+    Serial.print("IP address: ");
+    Serial.println(WiFi.localIP());
+
+    // Required to spread the searches out over the rate limit window
+    twitter.timeConfig();
+
+    // Checking the cert is the best way on an ESP32
+    // This will verify the server is trusted.
+    client.setCACert(twitter_server_cert);
+}
+
+void printTweet(TweetSearchResult tweet)
+{
+    Serial.print(tweet.username); //witnessmenow
+    Serial.print(": ");
+    Serial.println(tweet.text);
+
+    // Also available
+    //tweet.authorId
+    //tweet.tweetId
+    //tweet.name // Brian Lough
+}
+
+bool processTweets(TweetSearchResult tweet, int index, int numMessages)
+{
+    printTweet(tweet);
+    return true; // You can stop the callback by returning false
+}
+
+void loop()
+{
+    if (poller.isDue())
+    {
+        if (WiFi.status() != WL_CONNECTED)
+        {
+            WiFi.reconnect();
+            while (WiFi.status() != WL_CONNECTED)
+            {
+                delay(500);
+            }
+        }
+
+        // query must be url encoded. urlEncode is provided by the URLEncode.h library
+        String query = urlEncode("#dogs");
+
+        // The poller remembers the newest tweet, so only new tweets are returned
+        int numberOfResponses = poller.poll(processTweets, (char *)query.c_str(), true);
+        if (numberOfResponses >= 0)
+        {
+            Serial.print("Recieved ");
+            Serial.print(numberOfResponses);
+            Serial.println(" tweets");
+        }
+        else
+        {
+            Serial.println("error getting tweets");
+        }
+
+        Serial.print("Next check in ");
+        Serial.print(poller.timeUntilNextPoll() / 1000);
+        Serial.println(" seconds");
+        Serial.flush();
+    }
+
+    // Sleep until the next poll is due. The WiFi connection may drop while
+    // sleeping, so it's checked again above before polling.
+    esp_sleep_enable_timer_wakeup((uint64_t)poller.timeUntilNextPoll() * 1000);
+    esp_light_sleep_start();
+}
@@ -0,0 +1,135 @@
+/*
+TweESP32 - A Twitter API library for the ESP32 that can tweet
+
+Copyright (c) 2022  Brian Lough.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "DeadlineClient.h"
+
+DeadlineClient::DeadlineClient(Client &client, unsigned long budget, unsigned long start)
+{
+    _client = &client;
+    _start = start;
+    _budget = budget;
+    setTimeout(client.getTimeout());
+}
+
+int DeadlineClient::connect(IPAddress ip, uint16_t port)
+{
+    return expired() ? 0 : _client->connect(ip, port);
+}
+
+int DeadlineClient::connect(IPAddress ip, uint16_t port, int32_t timeout)
+{
+    return expired() ? 0 : _client->connect(ip, port, timeLeft(timeout));
+}
+
+int DeadlineClient::connect(const char *host, uint16_t port)
+{
+    return expired() ? 0 : _client->connect(host, port);
+}
+
+int DeadlineClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+    return expired() ? 0 : _client->connect(host, port, timeLeft(timeout));
+}
+
+size_t DeadlineClient::write(uint8_t c)
+{
+    return expired() ? 0 : _client->write(c);
+}
+
+size_t DeadlineClient::write(const uint8_t *buf, size_t size)
+{
+    return expired() ? 0 : _client->write(buf, size);
+}
+
+int DeadlineClient::available()
+{
+    return expired() ? 0 : _client->available();
+}
+
+int DeadlineClient::read()
+{
+    limitTimeout();
+    return expired() ? -1 : _client->read();
+}
+
+int DeadlineClient::read(uint8_t *buf, size_t size)
+{
+    limitTimeout();
+    return expired() ? -1 : _client->read(buf, size);
+}
+
+int DeadlineClient::peek()
+{
+    limitTimeout();
+    return expired() ? -1 : _client->peek();
+}
+
+void DeadlineClient::flush()
+{
+    _client->flush();
+}
+
+void DeadlineClient::stop()
+{
+    _client->stop();
+}
+
+uint8_t DeadlineClient::connected()
+{
+    return _client->connected();
+}
+
+DeadlineClient::operator bool()
+{
+    return (bool)*_client;
+}
+
+bool DeadlineClient::expired()
+{
+    return _budget != 0 && millis() - _start >= _budget;
+}
+
+unsigned long DeadlineClient::timeLeft(unsigned long limit)
+{
+    if (_budget == 0)
+    {
+        return limit;
+    }
+
+    unsigned long left = remaining();
+    return left < limit ? left : limit;
+}
+
+unsigned long DeadlineClient::remaining()
+{
+    if (_budget == 0 || expired())
+    {
+        return 0;
+    }
+
+    return _budget - (millis() - _start);
+}
+
+void DeadlineClient::limitTimeout()
+{
+    // Stream's timed reads (readBytes, readBytesUntil etc.) wait up to
+    // _timeout for each byte, so never let that go past the budget
+    _timeout = timeLeft(_timeout);
+}
@@ -0,0 +1,70 @@
+/*
+TweESP32 - A Twitter API library for the ESP32 that can tweet
+
+Copyright (c) 2022  Brian Lough.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef DeadlineClient_h
+#define DeadlineClient_h
+
+#include <Arduino.h>
+#include <Client.h>
+
+// Wraps a Client so that everything done with it, reading and writing, has
+// to finish within an overall time budget. Once the budget is used up reads
+// return nothing and writes fail, so anything using it gives up straight away
+// instead of waiting out its own timeout.
+class DeadlineClient : public Client
+{
+public:
+  // budget is in ms from start (a millis() value), 0 means there is no limit
+  DeadlineClient(Client &client, unsigned long budget, unsigned long start);
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(IPAddress ip, uint16_t port, int32_t timeout);
+  int connect(const char *host, uint16_t port);
+  int connect(const char *host, uint16_t port, int32_t timeout);
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *buf, size_t size);
+  int available();
+  int read();
+  int read(uint8_t *buf, size_t size);
+  int peek();
+  void flush();
+  void stop();
+  uint8_t connected();
+  operator bool();
+
+  Client *wrappedClient() { return _client; }
+
+  bool expired();
+
+  // The smaller of limit and the time left in the budget
+  unsigned long timeLeft(unsigned long limit);
+
+  // ms left in the budget, 0 if there is no budget
+  unsigned long remaining();
+
+private:
+  Client *_client;
+  unsigned long _start;
+  unsigned long _budget;
+
+  void limitTimeout();
+};
+
+#endif
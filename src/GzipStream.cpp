@@ -0,0 +1,226 @@
+/*
+TweESP32 - A Twitter API library for the ESP32 that can tweet
+
+Copyright (c) 2022  Brian Lough.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "TweESP32.h"
+#include "GzipStream.h"
+
+// gzip header flags (RFC 1952)
+#define GZIP_FLAG_HCRC 0x02
+#define GZIP_FLAG_EXTRA 0x04
+#define GZIP_FLAG_NAME 0x08
+#define GZIP_FLAG_COMMENT 0x10
+
+GzipStream::GzipStream(Stream &source)
+{
+    _source = &source;
+    setTimeout(source.getTimeout());
+}
+
+GzipStream::~GzipStream()
+{
+    free(_decompressor);
+    free(_window);
+}
+
+bool GzipStream::begin()
+{
+    uint8_t header[10];
+    if (!readSource(header, sizeof(header)) || header[0] != 0x1f || header[1] != 0x8b || header[2] != 8)
+    {
+#ifdef TWEESP32_SERIAL_OUTPUT
+        Serial.println(F("Invalid gzip header"));
+#endif
+        return false;
+    }
+
+    uint8_t flags = header[3];
+    if (flags & GZIP_FLAG_EXTRA)
+    {
+        uint8_t extraLength[2];
+        if (!readSource(extraLength, sizeof(extraLength)))
+        {
+            return false;
+        }
+
+        size_t toSkip = extraLength[0] | (extraLength[1] << 8);
+        uint8_t c;
+        while (toSkip > 0)
+        {
+            if (!readSource(&c, 1))
+            {
+                return false;
+            }
+            toSkip--;
+        }
+    }
+
+    if ((flags & GZIP_FLAG_NAME) && !skipSourceString())
+    {
+        return false;
+    }
+
+    if ((flags & GZIP_FLAG_COMMENT) && !skipSourceString())
+    {
+        return false;
+    }
+
+    if (flags & GZIP_FLAG_HCRC)
+    {
+        uint8_t crc[2];
+        if (!readSource(crc, sizeof(crc)))
+        {
+            return false;
+        }
+    }
+
+    _decompressor = (tinfl_decompressor *)malloc(sizeof(tinfl_decompressor));
+    _window = (uint8_t *)malloc(TWEESP32_GZIP_WINDOW_SIZE);
+    if (_decompressor == NULL || _window == NULL)
+    {
+#ifdef TWEESP32_SERIAL_OUTPUT
+        Serial.println(F("Not enough memory to inflate response"));
+#endif
+        return false;
+    }
+
+    tinfl_init(_decompressor);
+    return true;
+}
+
+int GzipStream::available()
+{
+    if (_available == 0)
+    {
+        fill();
+    }
+    return _available;
+}
+
+int GzipStream::read()
+{
+    if (_available == 0 && !fill())
+    {
+        return -1;
+    }
+
+    uint8_t c = _window[_readPos++];
+    _available--;
+    return c;
+}
+
+int GzipStream::peek()
+{
+    if (_available == 0 && !fill())
+    {
+        return -1;
+    }
+
+    return _window[_readPos];
+}
+
+size_t GzipStream::readBytes(char *buffer, size_t length)
+{
+    size_t copied = 0;
+    while (copied < length && (_available > 0 || fill()))
+    {
+        size_t toCopy = length - copied < _available ? length - copied : _available;
+        memcpy(buffer + copied, _window + _readPos, toCopy);
+        _readPos += toCopy;
+        _available -= toCopy;
+        copied += toCopy;
+    }
+    return copied;
+}
+
+size_t GzipStream::write(uint8_t c)
+{
+    // Read only
+    return 0;
+}
+
+bool GzipStream::fill()
+{
+    // Only inflate more once everything already inflated has been read,
+    // otherwise tinfl could overwrite bytes that are still unread
+    while (_available == 0 && !_finished && _decompressor != NULL)
+    {
+        if (_inputPos == _inputLength && !_sourceEnded)
+        {
+            // readBytes waits out the whole timeout when it gets less than
+            // asked for, which the last piece of a body always is once the
+            // server has closed the connection. So only ask for what has
+            // arrived, and wait for a single byte when nothing has yet
+            int waiting = _source->available();
+            size_t wanted = waiting <= 0 ? 1 : (size_t)waiting < sizeof(_input) ? waiting : sizeof(_input);
+            _inputLength = _source->readBytes(_input, wanted);
+            _inputPos = 0;
+            _compressedBytes += _inputLength;
+            if (_inputLength == 0)
+            {
+                _sourceEnded = true;
+            }
+        }
+
+        size_t inBytes = _inputLength - _inputPos;
+        size_t outBytes = TWEESP32_GZIP_WINDOW_SIZE - _writePos;
+        tinfl_status status = tinfl_decompress(_decompressor, _input + _inputPos, &inBytes, _window, _window + _writePos, &outBytes, _sourceEnded ? 0 : TINFL_FLAG_HAS_MORE_INPUT);
+
+        _inputPos += inBytes;
+        _readPos = _writePos;
+        _available = outBytes;
+        _decompressedBytes += outBytes;
+        _writePos = (_writePos + outBytes) & (TWEESP32_GZIP_WINDOW_SIZE - 1);
+
+        if (status <= TINFL_STATUS_DONE)
+        {
+#ifdef TWEESP32_SERIAL_OUTPUT
+            if (status < TINFL_STATUS_DONE)
+            {
+                Serial.print(F("Inflate failed: "));
+                Serial.println(status);
+            }
+#endif
+            _finished = true;
+        }
+    }
+
+    return _available > 0;
+}
+
+bool GzipStream::readSource(uint8_t *buffer, size_t length)
+{
+    size_t bytesRead = _source->readBytes(buffer, length);
+    _compressedBytes += bytesRead;
+    return bytesRead == length;
+}
+
+bool GzipStream::skipSourceString()
+{
+    uint8_t c;
+    do
+    {
+        if (!readSource(&c, 1))
+        {
+            return false;
+        }
+    } while (c != '\0');
+
+    return true;
+}
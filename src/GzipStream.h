@@ -0,0 +1,83 @@
+/*
+TweESP32 - A Twitter API library for the ESP32 that can tweet
+
+Copyright (c) 2022  Brian Lough.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef GzipStream_h
+#define GzipStream_h
+
+#include <Arduino.h>
+
+// The ESP32 has a copy of miniz in ROM, so inflating doesn't cost any flash
+#include "rom/miniz.h"
+
+// Size of the buffer compressed data is read into from the source Stream
+#define TWEESP32_GZIP_INPUT_SIZE 512
+
+// Deflate can reference up to 32KB back, so this is the only window size
+// that is safe for any response. It must be a power of 2.
+#define TWEESP32_GZIP_WINDOW_SIZE TINFL_LZ_DICT_SIZE
+
+// Wraps a Stream containing a gzip body and inflates it as it is read, so
+// it can be passed directly to deserializeJson. Only a small input buffer
+// and the inflate window are held in memory, never the whole body.
+class GzipStream : public Stream
+{
+public:
+  GzipStream(Stream &source);
+  ~GzipStream();
+
+  // Reads the gzip header and allocates the inflate state,
+  // returns false if the source is not gzip or memory is low.
+  bool begin();
+
+  int available();
+  int read();
+  int peek();
+  size_t readBytes(char *buffer, size_t length);
+  size_t write(uint8_t c);
+
+  // Bytes read from the source, i.e. what was sent over the network
+  size_t compressedBytesRead() { return _compressedBytes; }
+  size_t decompressedBytes() { return _decompressedBytes; }
+
+private:
+  Stream *_source;
+
+  tinfl_decompressor *_decompressor = NULL;
+  uint8_t *_window = NULL;
+  size_t _writePos = 0;
+  size_t _readPos = 0;
+  size_t _available = 0;
+
+  uint8_t _input[TWEESP32_GZIP_INPUT_SIZE];
+  size_t _inputPos = 0;
+  size_t _inputLength = 0;
+
+  bool _sourceEnded = false;
+  bool _finished = false;
+
+  size_t _compressedBytes = 0;
+  size_t _decompressedBytes = 0;
+
+  bool fill();
+  bool readSource(uint8_t *buffer, size_t length);
+  bool skipSourceString();
+};
+
+#endif
@@ -19,15 +19,47 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 */
 
 #include "TweESP32.h"
+#include "TweetStore.h"
+
+// Copies as much of src as fits, always null terminated
+static void copyErrorText(char *dest, const char *src, size_t destSize)
+{
+    if (src == NULL)
+    {
+        dest[0] = '\0';
+        return;
+    }
+    strncpy(dest, src, destSize - 1);
+    dest[destSize - 1] = '\0';
+}
+
+// Twitter's IDs are all digits, and have to fit in a buffer of bufferLength
+static bool isValidId(const char *id, size_t bufferLength)
+{
+    size_t length = 0;
+    while (id[length] != '\0')
+    {
+        if (length == bufferLength - 1 || !isdigit((unsigned char)id[length]))
+        {
+            return false;
+        }
+        length++;
+    }
+    return length > 0;
+}
 
 TweESP32::TweESP32(Client &client)
 {
     this->client = &client;
+    _connections[0].client = &client;
+    setSearchTweetFields(0);
 }
 
 TweESP32::TweESP32(Client &client, const char *consumerKey, const char *consumerSecret, const char *accessToken, const char *accessTokenSecret, const char *bearerToken)
 {
     this->client = &client;
+    _connections[0].client = &client;
+    setSearchTweetFields(0);
     lateInit(consumerKey, consumerSecret, accessToken, accessTokenSecret);
     if (bearerToken != NULL)
     {
@@ -38,17 +70,89 @@ TweESP32::TweESP32(Client &client, const char *consumerKey, const char *consumer
 TweESP32::TweESP32(Client &client, const char *bearerToken)
 {
     this->client = &client;
+    _connections[0].client = &client;
+    setSearchTweetFields(0);
     setBearerToken(bearerToken);
 }
 
-int TweESP32::makeRequestWithBody(const char *type, const char *command, const char *authorization, const char *body, const char *contentType, const char *host)
+TweESP32::~TweESP32()
+{
+    if (_connectionsAvailable != NULL)
+    {
+        vSemaphoreDelete(_connectionsAvailable);
+    }
+    if (_connectionsLock != NULL)
+    {
+        vSemaphoreDelete(_connectionsLock);
+    }
+}
+
+bool TweESP32::connectClient(DeadlineClient *requestClient, const char *host)
 {
+    // Connect and the TLS session cache use the real client, the handshake
+    // gets whatever is left of the budget as its timeout
+    Client *client = requestClient->wrappedClient();
     client->flush();
+    client->setTimeout(requestClient->timeLeft(TWEESP32_TIMEOUT));
+
+    bool appliedSession = false;
+    if (_tlsSessionCache != NULL)
+    {
+        appliedSession = _tlsSessionCache->apply(*client, host);
+    }
+
+    // With the budget spent the timeout above is 0, which would get the
+    // client's default (30s for the ESP32's WiFiClientSecure), not no time
+    if (requestClient->expired())
+    {
+        return false;
+    }
+
+    if (!client->connect(host, portNumber))
+    {
+        // Only worth a second go if the server turned down the saved session
+        if (!appliedSession || requestClient->expired() || !_tlsSessionCache->sessionRejected(*client, host))
+        {
+            return false;
+        }
+
+#ifdef TWEESP32_DEBUG
+        Serial.println(F("Saved TLS session was rejected, retrying with a full handshake"));
+#endif
+        _tlsSessionCache->clear(host);
+        client->stop();
+        client->setTimeout(requestClient->timeLeft(TWEESP32_TIMEOUT));
+        if (!client->connect(host, portNumber))
+        {
+            return false;
+        }
+    }
+
+    if (requestClient->expired())
+    {
+        client->stop();
+        return false;
+    }
+
+    if (_tlsSessionCache != NULL && _tlsSessionCache->save(*client, host))
+    {
+        resumedHandshakes++;
+    }
+    else
+    {
+        fullHandshakes++;
+    }
+
+    return true;
+}
+
+int TweESP32::sendRequestHeaders(DeadlineClient *client, const char *type, const char *command, const char *authorization, const char *contentType, size_t contentLength, const char *host)
+{
 #ifdef TWEESP32_DEBUG
     Serial.println(host);
 #endif
     client->setTimeout(TWEESP32_TIMEOUT);
-    if (!client->connect(host, portNumber))
+    if (!connectClient(client, host))
     {
 #ifdef TWEESP32_SERIAL_OUTPUT
         Serial.println(F("Connection failed"));
@@ -78,9 +182,32 @@ int TweESP32::makeRequestWithBody(const char *type, const char *command, const c
     }
 
     client->print(F("Content-Length: "));
-    client->println(strlen(body));
+    client->println((unsigned long)contentLength);
+
+    if (client->println() == 0)
+    {
+#ifdef TWEESP32_SERIAL_OUTPUT
+        Serial.println(F("Failed to send request"));
+#endif
+        return -2;
+    }
+
+    return 0;
+}
 
-    client->println();
+int TweESP32::makeRequestWithBody(const char *type, const char *command, const char *authorization, const char *body, const char *contentType, const char *host)
+{
+    DeadlineClient requestClient(*client, 0, millis());
+    return makeRequestWithBody(&requestClient, type, command, authorization, body, contentType, host);
+}
+
+int TweESP32::makeRequestWithBody(DeadlineClient *client, const char *type, const char *command, const char *authorization, const char *body, const char *contentType, const char *host)
+{
+    int headerResult = sendRequestHeaders(client, type, command, authorization, contentType, strlen(body), host);
+    if (headerResult < 0)
+    {
+        return headerResult;
+    }
 
     client->print(body);
 
@@ -92,7 +219,7 @@ int TweESP32::makeRequestWithBody(const char *type, const char *command, const c
         return -2;
     }
 
-    int statusCode = getHttpStatusCode();
+    int statusCode = getHttpStatusCode(client);
     return statusCode;
 }
 
@@ -106,11 +233,16 @@ int TweESP32::makePostRequest(const char *command, const char *authorization, co
     return makeRequestWithBody("POST ", command, authorization, body, contentType, host);
 }
 
-int TweESP32::makeGetRequest(const char *command, const char *authorization, const char *accept, const char *host)
+int TweESP32::makeGetRequest(const char *command, const char *authorization, const char *accept, const char *host, bool acceptGzip)
+{
+    DeadlineClient requestClient(*client, 0, millis());
+    return makeGetRequest(&requestClient, command, authorization, accept, host, acceptGzip);
+}
+
+int TweESP32::makeGetRequest(DeadlineClient *client, const char *command, const char *authorization, const char *accept, const char *host, bool acceptGzip)
 {
-    client->flush();
     client->setTimeout(TWEESP32_TIMEOUT);
-    if (!client->connect(host, portNumber))
+    if (!connectClient(client, host))
     {
 #ifdef TWEESP32_SERIAL_OUTPUT
         Serial.println(F("Connection failed"));
@@ -136,6 +268,11 @@ int TweESP32::makeGetRequest(const char *command, const char *authorization, con
         client->println(accept);
     }
 
+    if (acceptGzip)
+    {
+        client->println(F("Accept-Encoding: gzip"));
+    }
+
     if (authorization != NULL)
     {
         client->print(F("Authorization: "));
@@ -150,7 +287,7 @@ int TweESP32::makeGetRequest(const char *command, const char *authorization, con
         return -2;
     }
 
-    int statusCode = getHttpStatusCode();
+    int statusCode = getHttpStatusCode(client);
 
     return statusCode;
 }
@@ -162,8 +299,13 @@ void TweESP32::updateSigningKey()
     _signingKey[length] = '\0';
 }
 
-void TweESP32::updateNonce()
+void TweESP32::updateNonce(char *nonce)
 {
+    if (nonce == NULL)
+    {
+        nonce = _nonce;
+    }
+
     int i = 0;
     while (i < TWEESP32_NONCE_LENGTH)
     {
@@ -171,11 +313,11 @@ void TweESP32::updateNonce()
 
         if (isAlphaNumeric(c))
         {
-            _nonce[i] = c;
+            nonce[i] = c;
             i++;
         }
     }
-    _nonce[TWEESP32_NONCE_LENGTH] = '\0';
+    nonce[TWEESP32_NONCE_LENGTH] = '\0';
 }
 
 // Feels weird to have this here and not in the header, its the same as OAuthClient though
@@ -187,20 +329,25 @@ static int strcmp_pointer(const void *a, const void *b)
 // This function was ported to work with the ESP32 from https://github.com/arduino-libraries/Arduino_OAuth
 // The changes I made were to make it work with the ESP32 SHA1 encryption and Base64 methods.
 
-bool TweESP32::calculateSignature(const char *method, const char *url, unsigned long oauthTime, const char *queryParams, const char *bodyParams, char *out_sig)
+bool TweESP32::calculateSignature(const char *method, const char *url, unsigned long oauthTime, const char *queryParams, const char *bodyParams, char *out_sig, const char *nonce)
 {
     // This function is long due to the complexity of the OAuth signature.
     // It must collect all the parameters from the oauth, query, and body params,
     // then sort the param key values lexicographically. After these steps the
     // signature can be calculated.
 
+    if (nonce == NULL)
+    {
+        nonce = _nonce;
+    }
+
     // calculate the OAuth params
     String oauthParams;
 
     oauthParams += "oauth_consumer_key=";
     oauthParams += _consumerKey;
     oauthParams += "&oauth_nonce=";
-    oauthParams += _nonce;
+    oauthParams += nonce;
     oauthParams += "&oauth_signature_method=HMAC-SHA1&oauth_timestamp=";
     oauthParams += String(oauthTime);
     oauthParams += "&oauth_token=";
@@ -384,11 +531,11 @@ bool TweESP32::calculateSignature(const char *method, const char *url, unsigned
     }
 }
 
-unsigned long TweESP32::getEpoch()
+unsigned long TweESP32::getEpoch(uint32_t wait)
 {
     time_t now;
     struct tm timeinfo;
-    if (!getLocalTime(&timeinfo))
+    if (!getLocalTime(&timeinfo, wait))
     {
 #ifdef TWEESP32_DEBUG
         Serial.println("Failed to obtain time");
@@ -399,50 +546,42 @@ unsigned long TweESP32::getEpoch()
     return now;
 }
 
-void TweESP32::generateAuthHeader(unsigned long time, char *sig, char *outAuth)
+void TweESP32::generateAuthHeader(unsigned long time, char *sig, char *outAuth, const char *nonce)
 {
+    if (nonce == NULL)
+    {
+        nonce = _nonce;
+    }
+
     sprintf(outAuth, "OAuth oauth_consumer_key=\"%s\",oauth_token=\"%s\",oauth_signature_method=\"HMAC-SHA1\",oauth_timestamp=\"%d\",oauth_nonce=\"%s\",oauth_version=\"1.0\",oauth_signature=\"%s\"",
             _consumerKey,
             _accessToken,
             time,
-            _nonce,
+            nonce,
             sig);
 }
 
-void TweESP32::timeConfig()
-{
-    configTime(0, 0, ntpServer);
-}
-
-bool TweESP32::sendTweet(char *message, char *replyTo)
+bool TweESP32::generateOAuthHeader(const char *method, const char *url, const char *queryParams, const char *bodyParams, char *outAuth, char *nonce)
 {
-
-    char body[500];
-    if (replyTo != NULL)
-    {
-        sprintf(body, "{\"text\": \"%s\", \"reply\": {\"in_reply_to_tweet_id\": \"%s\"}}", message, replyTo);
-    }
-    else
+    // The nonce is never shared between requests so requests on other tasks can't change it
+    char stackNonce[TWEESP32_NONCE_LENGTH + 1];
+    if (nonce == NULL)
     {
-        sprintf(body, "{\"text\":\"%s\"}", message);
+        nonce = stackNonce;
     }
-
-    updateNonce();
+    updateNonce(nonce);
     unsigned long currentTime = getEpoch();
 
 #ifdef TWEESP32_DEBUG
-    Serial.print("body: ");
-    Serial.println(body);
-
     Serial.print("OAuth Nonce: ");
-    Serial.println(_nonce);
+    Serial.println(nonce);
 
     Serial.print("OAuth Time: ");
     Serial.println(currentTime);
 #endif
 
     char sig[100];
-    bool generatedSig = calculateSignature("POST", "https://api.twitter.com/2/tweets", currentTime, "", "", sig);
+    bool generatedSig = calculateSignature(method, url, currentTime, queryParams, bodyParams, sig, nonce);
     if (!generatedSig)
     {
 #ifdef TWEESP32_SERIAL_OUTPUT
@@ -451,17 +590,123 @@ bool TweESP32::sendTweet(char *message, char *replyTo)
         return false;
     }
 
-    char auth[900];
-    generateAuthHeader(currentTime, sig, auth);
+    generateAuthHeader(currentTime, sig, outAuth, nonce);
 #ifdef TWEESP32_DEBUG
     Serial.print("auth: ");
-    Serial.println(auth);
+    Serial.println(outAuth);
+#endif
+    return true;
+}
+
+void TweESP32::timeConfig()
+{
+    configTime(0, 0, ntpServer);
+}
+
+bool TweESP32::sendTweet(char *message, char *replyTo, const char *mediaId)
+{
+    bool success = sendTweet(_defaultContext, message, replyTo, mediaId);
+    if (success)
+    {
+        strcpy(lastTweetId, _defaultContext.tweetId);
+    }
+    lastError = _defaultContext.error;
+    return success;
+}
+
+bool TweESP32::sendTweet(TweESP32Context &context, char *message, char *replyTo, const char *mediaId)
+{
+    unsigned long startTime = millis();
+    context.error = TweESP32Error();
+    context.timeRemaining = 0;
+
+    // Checked before connecting, so a bad tweet doesn't cost a request
+    size_t messageLength = strlen(message);
+    int weight = tweetWeightedLength(message);
+    if (weight < 0)
+    {
+        setInvalidTweetError(context.error, "Tweet is not valid UTF-8");
+        return false;
+    }
+    bool tooLong = weight > TWEESP32_MAX_TWEET_WEIGHT;
+    bool tooLarge = tweetJsonLength(message, messageLength) > TWEESP32_MAX_TWEET_BYTES;
+    if (tooLong || tooLarge)
+    {
+        if (!truncateLongTweets)
+        {
+            if (tooLong)
+            {
+                setInvalidTweetError(context.error, "Tweet is too long");
+            }
+            else
+            {
+                // Twitter would take it, it just doesn't fit in context.request
+                setInvalidTweetError(context.error, "Tweet is too large for the request", TWEESP32_TWEET_TOO_LARGE);
+            }
+            return false;
+        }
+        messageLength = tweetFitLength(message);
+    }
+
+    // These go into the body as they are, TWEESP32_REQUEST_LENGTH leaves
+    // room for them at their longest
+    if (replyTo != NULL && !isValidId(replyTo, TWEESP32_TWEET_ID_LENGTH))
+    {
+        setInvalidTweetError(context.error, "Reply ID is not a tweet ID");
+        return false;
+    }
+    if (mediaId != NULL && !isValidId(mediaId, TWEESP32_MEDIA_ID_LENGTH))
+    {
+        setInvalidTweetError(context.error, "Media ID is not a media ID");
+        return false;
+    }
+
+    // Quotes, backslashes and new lines in the message would break the JSON
+    char *body = context.request;
+    strcpy(body, "{\"text\":\"");
+    size_t bodyLength = strlen(body);
+    bodyLength += tweetJsonEscape(body + bodyLength, message, messageLength);
+    strcpy(body + bodyLength, "\"");
+    if (replyTo != NULL)
+    {
+        char replyBuff[80];
+        snprintf(replyBuff, sizeof(replyBuff), ",\"reply\":{\"in_reply_to_tweet_id\":\"%s\"}", replyTo);
+        strcat(body, replyBuff);
+    }
+
+    if (mediaId != NULL)
+    {
+        char mediaBuff[80];
+        snprintf(mediaBuff, sizeof(mediaBuff), ",\"media\":{\"media_ids\":[\"%s\"]}", mediaId);
+        strcat(body, mediaBuff);
+    }
+    strcat(body, "}");
+
+#ifdef TWEESP32_DEBUG
+    Serial.print("body: ");
+    Serial.println(body);
 #endif
 
-    int statusCode = makePostRequest(TWEESP32_TWEETS_ENDPOINT, auth, body);
+    char *auth = context.auth;
+    if (!generateOAuthHeader("POST", "https://api.twitter.com/2/tweets", "", "", auth, context.nonce))
+    {
+        setLocalError(context.error, TWEESP32_SIGNING_FAILED, "Failed to generate OAuth signature", false);
+        return false;
+    }
+
+    TweESP32Connection *connection = acquireConnection(context.timeout, startTime);
+    if (connection == NULL)
+    {
+        setDeadlineError(context.error);
+        return false;
+    }
+    DeadlineClient requestClient(*connection->client, context.timeout, startTime);
+    DeadlineClient *client = &requestClient;
+
+    int statusCode = makeRequestWithBody(client, "POST ", TWEESP32_TWEETS_ENDPOINT, auth, body);
     if (statusCode > 0)
     {
-        skipHeaders();
+        readHeaders(client, context);
     }
     unsigned long now = millis();
 
@@ -488,8 +733,8 @@ bool TweESP32::sendTweet(char *message, char *replyTo)
         if (!error)
         {
             const char *data_id = doc["data"]["id"];
-            strncpy(lastTweetId, data_id, strlen(data_id));
-            lastTweetId[strlen(data_id)] = '\0';
+            strncpy(context.tweetId, data_id, TWEESP32_TWEET_ID_LENGTH - 1);
+            context.tweetId[TWEESP32_TWEET_ID_LENGTH - 1] = '\0';
             success = true;
         }
         else
@@ -498,21 +743,161 @@ bool TweESP32::sendTweet(char *message, char *replyTo)
             Serial.print(F("deserializeJson() failed with code "));
             Serial.println(error.c_str());
 #endif
+            setLocalError(context.error, TWEESP32_INVALID_RESPONSE, "Failed to parse response", true);
+            copyErrorText(context.error.detail, error.c_str(), sizeof(context.error.detail));
         }
     }
     else
     {
-        parseError();
+        parseError(client, statusCode, context.error);
     }
 
-    closeClient();
+    closeClient(client);
+    releaseConnection(connection);
+    finishRequest(context, requestClient, success);
     return success;
 }
 
+int TweESP32::sendTweetThread(char *message, char *replyTo)
+{
+    int sent = sendTweetThread(_defaultContext, message, replyTo);
+    if (sent > 0)
+    {
+        strcpy(lastTweetId, _defaultContext.tweetId);
+    }
+    lastError = _defaultContext.error;
+    return sent;
+}
+
+int TweESP32::sendTweetThread(TweESP32Context &context, char *message, char *replyTo)
+{
+    if (tweetWeightedLength(message) < 0)
+    {
+        setInvalidTweetError(context.error, "Tweet is not valid UTF-8");
+        return 0;
+    }
+
+    int numParts = tweetPartCount(message);
+    if (numParts < 0)
+    {
+        setInvalidTweetError(context.error, "Tweet can't be split");
+        return 0;
+    }
+
+    if (numParts <= 1)
+    {
+        return sendTweet(context, message, replyTo) ? 1 : 0;
+    }
+
+    // The numbering takes room from each part, which can mean more parts
+    // (and a longer number), so count again until it settles
+    char numbering[16];
+    size_t reserved;
+    while (true)
+    {
+        sprintf(numbering, " %d/%d", numParts, numParts);
+        reserved = strlen(numbering);
+        int count = tweetPartCount(message, TWEESP32_MAX_TWEET_WEIGHT - reserved, TWEESP32_MAX_TWEET_BYTES - reserved);
+        if (count < 0)
+        {
+            setInvalidTweetError(context.error, "Tweet can't be split");
+            return 0;
+        }
+
+        bool settled = (count <= numParts);
+        numParts = count;
+        if (settled)
+        {
+            break;
+        }
+    }
+
+    char part[TWEESP32_MAX_TWEET_BYTES + 1];
+    char previousId[TWEESP32_TWEET_ID_LENGTH];
+    const char *remaining = message;
+    for (int i = 1; i <= numParts; i++)
+    {
+        size_t length;
+        remaining = nextTweetPart(remaining, length, TWEESP32_MAX_TWEET_WEIGHT - reserved, TWEESP32_MAX_TWEET_BYTES - reserved);
+        memcpy(part, remaining, length);
+        sprintf(part + length, " %d/%d", i, numParts);
+        remaining += length;
+
+        char *inReplyTo = replyTo;
+        if (i > 1)
+        {
+            strcpy(previousId, context.tweetId);
+            inReplyTo = previousId;
+        }
+
+        if (!sendTweet(context, part, inReplyTo))
+        {
+            return i - 1;
+        }
+    }
+
+    return numParts;
+}
+
+TweetSearchResult TweESP32::getSearchResult(JsonDocument &doc, int i, int resultCount, bool includeUsername)
+{
+    TweetSearchResult result = {};
+    result.authorId = doc["data"][i]["author_id"].as<const char *>();
+    result.tweetId = doc["data"][i]["id"].as<const char *>();
+    result.text = doc["data"][i]["text"].as<const char *>();
+
+    // These will be NULL/0 if they were not requested
+    result.createdAt = doc["data"][i]["created_at"].as<const char *>();
+    result.conversationId = doc["data"][i]["conversation_id"].as<const char *>();
+    result.retweetCount = doc["data"][i]["public_metrics"]["retweet_count"].as<int>();
+    result.replyCount = doc["data"][i]["public_metrics"]["reply_count"].as<int>();
+    result.likeCount = doc["data"][i]["public_metrics"]["like_count"].as<int>();
+    result.quoteCount = doc["data"][i]["public_metrics"]["quote_count"].as<int>();
+
+    if (includeUsername)
+    {
+        int usersArraySize = doc["includes"]["users"].size();
+        if (usersArraySize != resultCount)
+        {
+            //We have less user objects than messages, which means multiple message are from the same user
+            // we nee to check the authorID against the user objects to match names
+
+            for (int j = 0; j < usersArraySize; j++)
+            {
+                const char *user_Id = doc["includes"]["users"][j]["id"];
+                if (strcmp(result.authorId, user_Id) == 0)
+                {
+                    result.name = doc["includes"]["users"][j]["name"].as<const char *>();
+                    result.username = doc["includes"]["users"][j]["username"].as<const char *>();
+                    break;
+                }
+            }
+        }
+        else
+        {
+            result.name = doc["includes"]["users"][i]["name"].as<const char *>();
+            result.username = doc["includes"]["users"][i]["username"].as<const char *>();
+        }
+    }
+
+    return result;
+}
+
 int TweESP32::searchTweets(processTweetSearch searchCallback, char *query, bool includeUsername, char *since_id)
 {
+    int resultNum = searchTweets(_defaultContext, searchCallback, query, includeUsername, since_id);
+    lastError = _defaultContext.error;
+    return resultNum;
+}
+
+int TweESP32::searchTweets(TweESP32Context &context, processTweetSearch searchCallback, char *query, bool includeUsername, char *since_id, const char *paginationToken)
+{
+    unsigned long startTime = millis();
+    context.error = TweESP32Error();
+    context.timeRemaining = 0;
+    context.nextToken[0] = '\0';
 
-    char command[500];
+    char *command = context.request;
     sprintf(command, searchEndpointAndParams, query);
 
     if (includeUsername)
@@ -520,6 +905,8 @@ int TweESP32::searchTweets(processTweetSearch searchCallback, char *query, bool
         strcat(command, searchIncludeNameParams);
     }
 
+    strcat(command, _searchTweetFieldsParams);
+
     if (since_id != NULL)
     {
         char sinceBuff[50];
@@ -527,12 +914,18 @@ int TweESP32::searchTweets(processTweetSearch searchCallback, char *query, bool
         strcat(command, sinceBuff);
     }
 
+    if (paginationToken != NULL && paginationToken[0] != '\0')
+    {
+        strcat(command, "&pagination_token=");
+        strncat(command, paginationToken, TWEESP32_NEXT_TOKEN_LENGTH - 1);
+    }
+
 #ifdef TWEESP32_DEBUG
     Serial.println(command);
     printStack();
 #endif
 
-    char auth[300];
+    char *auth = context.auth;
     sprintf(auth, "Bearer %s", _bearerToken);
 
 #ifdef TWEESP32_DEBUG
@@ -540,10 +933,20 @@ int TweESP32::searchTweets(processTweetSearch searchCallback, char *query, bool
     Serial.println(auth);
 #endif
 
-    int statusCode = makeGetRequest(command, auth);
+    TweESP32Connection *connection = acquireConnection(context.timeout, startTime);
+    if (connection == NULL)
+    {
+        setDeadlineError(context.error);
+        return -1;
+    }
+    DeadlineClient requestClient(*connection->client, context.timeout, startTime);
+    DeadlineClient *client = &requestClient;
+
+    int statusCode = makeGetRequest(client, command, auth, "application/json", TWEESP32_HOST, useGzip);
+    bool gzipped = false;
     if (statusCode > 0)
     {
-        skipHeaders();
+        gzipped = readHeaders(client, context);
     }
     unsigned long now = millis();
 
@@ -552,55 +955,62 @@ int TweESP32::searchTweets(processTweetSearch searchCallback, char *query, bool
     Serial.println(statusCode);
 #endif
 
+    // Error responses are gzipped as well
+    Stream *body = client;
+    GzipStream gzipStream(*client);
+    bool inflating = gzipped && gzipStream.begin();
+    if (inflating)
+    {
+        body = &gzipStream;
+    }
+
     int resultNum = -1;
     if (statusCode == 200)
     {
+        if (gzipped && !inflating)
+        {
+            setLocalError(context.error, TWEESP32_INVALID_RESPONSE, "Failed to start inflating response", true);
+            closeClient(client);
+            releaseConnection(connection);
+            finishRequest(context, requestClient, false);
+            return -1;
+        }
 
         DynamicJsonDocument doc(searchWithNameBufferSize);
 
         // Parse JSON object
 #ifndef TWEESP32_PRINT_JSON_PARSE
-        DeserializationError error = deserializeJson(doc, *client);
+        DeserializationError error = deserializeJson(doc, *body, DeserializationOption::Filter(_searchFilter));
 #else
-        ReadLoggingStream loggingStream(*client, Serial);
-        DeserializationError error = deserializeJson(doc, loggingStream);
+        ReadLoggingStream loggingStream(*body, Serial);
+        DeserializationError error = deserializeJson(doc, loggingStream, DeserializationOption::Filter(_searchFilter));
 #endif
         if (!error)
         {
-            TweetSearchResult result;
-
             int resultCount = doc["meta"]["result_count"];
-            for (int i = 0; i < resultCount; i++)
-            {
-                result.authorId = doc["data"][i]["author_id"].as<const char *>();
-                result.tweetId = doc["data"][i]["id"].as<const char *>();
-                result.text = doc["data"][i]["text"].as<const char *>();
 
-                if (includeUsername)
+            // Handy to pass as the since_id of the next search
+            const char *newestId = doc["meta"]["newest_id"] | "";
+            strncpy(context.tweetId, newestId, TWEESP32_TWEET_ID_LENGTH - 1);
+            context.tweetId[TWEESP32_TWEET_ID_LENGTH - 1] = '\0';
+
+            // Only there when more than a page of tweets matched
+            const char *nextToken = doc["meta"]["next_token"] | "";
+            strncpy(context.nextToken, nextToken, TWEESP32_NEXT_TOKEN_LENGTH - 1);
+            context.nextToken[TWEESP32_NEXT_TOKEN_LENGTH - 1] = '\0';
+
+            // Results are newest first, add them the other way round so get(0) is the newest
+            if (context.store != NULL)
+            {
+                for (int i = resultCount - 1; i >= 0; i--)
                 {
-                    int usersArraySize = doc["includes"]["users"].size();
-                    if (usersArraySize != resultCount)
-                    {
-                        //We have less user objects than messages, which means multiple message are from the same user
-                        // we nee to check the authorID against the user objects to match names
-
-                        for (int j = 0; j < usersArraySize; j++)
-                        {
-                            const char *user_Id = doc["includes"]["users"][j]["id"];
-                            if (strcmp(result.authorId, user_Id) == 0)
-                            {
-                                result.name = doc["includes"]["users"][j]["name"].as<const char *>();
-                                result.username = doc["includes"]["users"][j]["username"].as<const char *>();
-                                break;
-                            }
-                        }
-                    }
-                    else
-                    {
-                        result.name = doc["includes"]["users"][i]["name"].as<const char *>();
-                        result.username = doc["includes"]["users"][i]["username"].as<const char *>();
-                    }
+                    context.store->add(getSearchResult(doc, i, resultCount, includeUsername));
                 }
+            }
+
+            for (int i = 0; i < resultCount && searchCallback != NULL; i++)
+            {
+                TweetSearchResult result = getSearchResult(doc, i, resultCount, includeUsername);
 
                 bool continueCallback = searchCallback(result, i, resultCount);
                 // User has decided to end the callbacks
@@ -611,6 +1021,16 @@ int TweESP32::searchTweets(processTweetSearch searchCallback, char *query, bool
             }
 
             resultNum = resultCount;
+
+#ifdef TWEESP32_DEBUG
+            if (inflating)
+            {
+                Serial.print(F("gzip: received "));
+                Serial.print((unsigned long)gzipStream.compressedBytesRead());
+                Serial.print(F(" bytes, inflated to "));
+                Serial.println((unsigned long)gzipStream.decompressedBytes());
+            }
+#endif
         }
         else
         {
@@ -618,45 +1038,435 @@ int TweESP32::searchTweets(processTweetSearch searchCallback, char *query, bool
             Serial.print(F("deserializeJson() failed with code "));
             Serial.println(error.c_str());
 #endif
+            // Running out of memory will happen again, a cut off response might not
+            if (error == DeserializationError::NoMemory)
+            {
+                setLocalError(context.error, TWEESP32_INVALID_RESPONSE, "Response too big, increase searchWithNameBufferSize", false);
+            }
+            else
+            {
+                setLocalError(context.error, TWEESP32_INVALID_RESPONSE, "Failed to parse response", true);
+                copyErrorText(context.error.detail, error.c_str(), sizeof(context.error.detail));
+            }
         }
     }
     else
     {
-        parseError();
+        parseError(body, statusCode, context.error);
     }
 
-    closeClient();
+    closeClient(client);
+    releaseConnection(connection);
+    finishRequest(context, requestClient, resultNum >= 0);
     return resultNum;
 }
 
-int TweESP32::getContentLength()
+bool TweESP32::uploadMedia(Stream &media, size_t mediaLength, const char *mediaType, char *outMediaId)
+{
+    bool success = uploadMedia(_defaultContext, media, mediaLength, mediaType, outMediaId);
+    lastError = _defaultContext.error;
+    return success;
+}
+
+bool TweESP32::uploadMedia(TweESP32Context &context, Stream &media, size_t mediaLength, const char *mediaType, char *outMediaId)
 {
+    unsigned long startTime = millis();
+    context.error = TweESP32Error();
+    context.timeRemaining = 0;
 
-    if (client->find("Content-Length:"))
+    // Checked before connecting, it has to fit in the INIT request
+    if (mediaType == NULL || mediaType[0] == '\0' || strlen(mediaType) >= TWEESP32_MEDIA_TYPE_LENGTH)
     {
-        int contentLength = client->parseInt();
-#ifdef TWEESP32_DEBUG
-        Serial.print(F("Content-Length: "));
-        Serial.println(contentLength);
-#endif
-        return contentLength;
+        setLocalError(context.error, TWEESP32_INVALID_MEDIA_TYPE, "Media type is empty or too long", false);
+        return false;
     }
 
-    return -1;
+    // One connection is used for the whole upload, requests are still made one after another
+    TweESP32Connection *connection = acquireConnection(context.timeout, startTime);
+    if (connection == NULL)
+    {
+        setDeadlineError(context.error);
+        return false;
+    }
+    DeadlineClient requestClient(*connection->client, context.timeout, startTime);
+    DeadlineClient *client = &requestClient;
+
+    if (!initMediaUpload(client, context, mediaLength, mediaType, outMediaId))
+    {
+        releaseConnection(connection);
+        finishRequest(context, requestClient, false);
+        return false;
+    }
+
+    int segmentIndex = 0;
+    size_t remaining = mediaLength;
+    while (remaining > 0)
+    {
+        size_t segmentLength = remaining < mediaSegmentSize ? remaining : mediaSegmentSize;
+        if (!appendMedia(client, context, media, outMediaId, segmentIndex, segmentLength))
+        {
+            releaseConnection(connection);
+            finishRequest(context, requestClient, false);
+            return false;
+        }
+
+        remaining -= segmentLength;
+        segmentIndex++;
+    }
+
+    bool success = finalizeMediaUpload(client, context, outMediaId);
+    releaseConnection(connection);
+    finishRequest(context, requestClient, success);
+    return success;
+}
+
+bool TweESP32::signMediaUpload(TweESP32Context &context, const char *bodyParams)
+{
+    char url[100];
+    snprintf(url, sizeof(url), "https://%s" TWEESP32_MEDIA_UPLOAD_ENDPOINT, uploadHost);
+    if (!generateOAuthHeader("POST", url, "", bodyParams, context.auth, context.nonce))
+    {
+        setLocalError(context.error, TWEESP32_SIGNING_FAILED, "Failed to generate OAuth signature", false);
+        return false;
+    }
+
+    return true;
+}
+
+bool TweESP32::initMediaUpload(DeadlineClient *client, TweESP32Context &context, size_t mediaLength, const char *mediaType, char *outMediaId)
+{
+    // The signature needs the raw values, the body needs them url encoded
+    // (up to 3 times as long). 60 covers the rest, total_bytes included
+    char bodyParams[60 + TWEESP32_MEDIA_TYPE_LENGTH];
+    snprintf(bodyParams, sizeof(bodyParams), "command=INIT&media_type=%s&total_bytes=%lu", mediaType, (unsigned long)mediaLength);
+
+    char body[60 + 3 * TWEESP32_MEDIA_TYPE_LENGTH];
+    snprintf(body, sizeof(body), "command=INIT&media_type=%s&total_bytes=%lu", urlEncode(mediaType).c_str(), (unsigned long)mediaLength);
+
+    if (!signMediaUpload(context, bodyParams))
+    {
+        return false;
+    }
+
+    int statusCode = makeRequestWithBody(client, "POST ", TWEESP32_MEDIA_UPLOAD_ENDPOINT, context.auth, body, "application/x-www-form-urlencoded", uploadHost);
+    if (statusCode > 0)
+    {
+        readHeaders(client, context);
+    }
+
+#ifdef TWEESP32_DEBUG
+    Serial.print("status Code");
+    Serial.println(statusCode);
+#endif
+
+    bool success = false;
+    if (statusCode >= 200 && statusCode < 300)
+    {
+        success = parseMediaId(client, outMediaId, context.error);
+    }
+    else
+    {
+        parseError(client, statusCode, context.error);
+    }
+
+    closeClient(client);
+    return success;
+}
+
+bool TweESP32::appendMedia(DeadlineClient *client, TweESP32Context &context, Stream &media, const char *mediaId, int segmentIndex, size_t segmentLength)
+{
+    // Multipart form fields are not included in the OAuth signature
+    if (!signMediaUpload(context, ""))
+    {
+        return false;
+    }
+
+    char *bodyStart = context.request;
+    sprintf(bodyStart,
+            "--" TWEESP32_MULTIPART_BOUNDARY "\r\n"
+            "Content-Disposition: form-data; name=\"command\"\r\n\r\nAPPEND\r\n"
+            "--" TWEESP32_MULTIPART_BOUNDARY "\r\n"
+            "Content-Disposition: form-data; name=\"media_id\"\r\n\r\n%s\r\n"
+            "--" TWEESP32_MULTIPART_BOUNDARY "\r\n"
+            "Content-Disposition: form-data; name=\"segment_index\"\r\n\r\n%d\r\n"
+            "--" TWEESP32_MULTIPART_BOUNDARY "\r\n"
+            "Content-Disposition: form-data; name=\"media\"; filename=\"media\"\r\n"
+            "Content-Type: application/octet-stream\r\n\r\n",
+            mediaId,
+            segmentIndex);
+    const char *bodyEnd = "\r\n--" TWEESP32_MULTIPART_BOUNDARY "--\r\n";
+
+    size_t contentLength = strlen(bodyStart) + segmentLength + strlen(bodyEnd);
+    int headerResult = sendRequestHeaders(client, "POST ", TWEESP32_MEDIA_UPLOAD_ENDPOINT, context.auth, "multipart/form-data; boundary=" TWEESP32_MULTIPART_BOUNDARY, contentLength, uploadHost);
+    if (headerResult < 0)
+    {
+        parseError(client, headerResult, context.error);
+        closeClient(client);
+        return false;
+    }
+
+    client->print(bodyStart);
+    if (!streamToClient(client, media, segmentLength, context.error))
+    {
+        closeClient(client);
+        return false;
+    }
+
+    if (client->print(bodyEnd) == 0)
+    {
+        parseError(client, -2, context.error);
+        closeClient(client);
+        return false;
+    }
+
+    int statusCode = getHttpStatusCode(client);
+
+#ifdef TWEESP32_DEBUG
+    Serial.print("status Code");
+    Serial.println(statusCode);
+#endif
+
+    // A successful APPEND has no body
+    bool success = statusCode >= 200 && statusCode < 300;
+    if (!success)
+    {
+        if (statusCode > 0)
+        {
+            readHeaders(client, context);
+        }
+        parseError(client, statusCode, context.error);
+    }
+
+    closeClient(client);
+    return success;
+}
+
+bool TweESP32::finalizeMediaUpload(DeadlineClient *client, TweESP32Context &context, const char *mediaId)
+{
+    char body[100];
+    snprintf(body, sizeof(body), "command=FINALIZE&media_id=%s", mediaId);
+
+    if (!signMediaUpload(context, body))
+    {
+        return false;
+    }
+
+    int statusCode = makeRequestWithBody(client, "POST ", TWEESP32_MEDIA_UPLOAD_ENDPOINT, context.auth, body, "application/x-www-form-urlencoded", uploadHost);
+
+#ifdef TWEESP32_DEBUG
+    Serial.print("status Code");
+    Serial.println(statusCode);
+#endif
+
+    bool success = statusCode >= 200 && statusCode < 300;
+    if (!success)
+    {
+        if (statusCode > 0)
+        {
+            readHeaders(client, context);
+        }
+        parseError(client, statusCode, context.error);
+    }
+
+    closeClient(client);
+    return success;
 }
 
-void TweESP32::skipHeaders(bool tossUnexpectedForJSON)
+bool TweESP32::streamToClient(Client *client, Stream &source, size_t length, TweESP32Error &error)
 {
-    // Skip HTTP headers
-    if (!client->find("\r\n\r\n"))
+    uint8_t buffer[TWEESP32_MEDIA_CHUNK_SIZE];
+    size_t remaining = length;
+    while (remaining > 0)
     {
+        size_t toRead = remaining < sizeof(buffer) ? remaining : sizeof(buffer);
+        size_t bytesRead = source.readBytes(buffer, toRead);
+        if (bytesRead == 0)
+        {
 #ifdef TWEESP32_SERIAL_OUTPUT
-        Serial.println(F("Invalid response"));
+            Serial.println(F("Media stream ended early"));
 #endif
-        return;
+            setLocalError(error, TWEESP32_MEDIA_READ_FAILED, "Media stream ended early", false);
+            return false;
+        }
+
+        if (client->write(buffer, bytesRead) != bytesRead)
+        {
+#ifdef TWEESP32_SERIAL_OUTPUT
+            Serial.println(F("Failed to send media"));
+#endif
+            parseError(client, -2, error);
+            return false;
+        }
+
+        remaining -= bytesRead;
+
+        // give the esp a breather
+        yield();
+    }
+
+    return true;
+}
+
+bool TweESP32::parseMediaId(Client *client, char *outMediaId, TweESP32Error &error)
+{
+    StaticJsonDocument<32> filter;
+    filter["media_id_string"] = true;
+
+    StaticJsonDocument<96> doc;
+
+    // Parse JSON object
+#ifndef TWEESP32_PRINT_JSON_PARSE
+    DeserializationError parseResult = deserializeJson(doc, *client, DeserializationOption::Filter(filter));
+#else
+    ReadLoggingStream loggingStream(*client, Serial);
+    DeserializationError parseResult = deserializeJson(doc, loggingStream, DeserializationOption::Filter(filter));
+#endif
+    if (parseResult)
+    {
+#ifdef TWEESP32_SERIAL_OUTPUT
+        Serial.print(F("deserializeJson() failed with code "));
+        Serial.println(parseResult.c_str());
+#endif
+        setLocalError(error, TWEESP32_INVALID_RESPONSE, "Failed to parse response", true);
+        copyErrorText(error.detail, parseResult.c_str(), sizeof(error.detail));
+        return false;
+    }
+
+    const char *mediaId = doc["media_id_string"];
+    if (mediaId == NULL)
+    {
+        setLocalError(error, TWEESP32_INVALID_RESPONSE, "Response had no media_id_string", true);
+        return false;
+    }
+
+    strncpy(outMediaId, mediaId, TWEESP32_MEDIA_ID_LENGTH - 1);
+    outMediaId[TWEESP32_MEDIA_ID_LENGTH - 1] = '\0';
+    return true;
+}
+
+void TweESP32::setSearchTweetFields(uint8_t tweetFields)
+{
+    _searchTweetFieldsParams[0] = '\0';
+    if (tweetFields != 0)
+    {
+        strcpy(_searchTweetFieldsParams, "&tweet.fields=");
+        if (tweetFields & TWEESP32_TWEET_FIELD_CREATED_AT)
+        {
+            strcat(_searchTweetFieldsParams, "created_at,");
+        }
+        if (tweetFields & TWEESP32_TWEET_FIELD_CONVERSATION_ID)
+        {
+            strcat(_searchTweetFieldsParams, "conversation_id,");
+        }
+        if (tweetFields & TWEESP32_TWEET_FIELD_PUBLIC_METRICS)
+        {
+            strcat(_searchTweetFieldsParams, "public_metrics,");
+        }
+
+        // remove the trailing comma
+        _searchTweetFieldsParams[strlen(_searchTweetFieldsParams) - 1] = '\0';
+    }
+
+    // The filter only keeps what searchTweets reads into TweetSearchResult,
+    // anything else in the response is skipped while parsing
+    _searchFilter.clear();
+    _searchFilter["meta"]["result_count"] = true;
+    _searchFilter["meta"]["newest_id"] = true;
+    _searchFilter["meta"]["next_token"] = true;
+
+    JsonObject tweetFilter = _searchFilter["data"].createNestedObject();
+    tweetFilter["id"] = true;
+    tweetFilter["author_id"] = true;
+    tweetFilter["text"] = true;
+    if (tweetFields & TWEESP32_TWEET_FIELD_CREATED_AT)
+    {
+        tweetFilter["created_at"] = true;
+    }
+    if (tweetFields & TWEESP32_TWEET_FIELD_CONVERSATION_ID)
+    {
+        tweetFilter["conversation_id"] = true;
+    }
+    if (tweetFields & TWEESP32_TWEET_FIELD_PUBLIC_METRICS)
+    {
+        tweetFilter["public_metrics"] = true;
+    }
+
+    JsonObject userFilter = _searchFilter["includes"]["users"].createNestedObject();
+    userFilter["id"] = true;
+    userFilter["name"] = true;
+    userFilter["username"] = true;
+}
+
+int TweESP32::getContentLength(Client *client)
+{
+
+    if (client->find("Content-Length:"))
+    {
+        int contentLength = client->parseInt();
+#ifdef TWEESP32_DEBUG
+        Serial.print(F("Content-Length: "));
+        Serial.println(contentLength);
+#endif
+        return contentLength;
     }
 
-    if (tossUnexpectedForJSON)
+    return -1;
+}
+
+bool TweESP32::readHeaders(Client *client, TweESP32Context &context)
+{
+    // Read the headers a line at a time, picking out the few that are used
+    bool gzipped = false;
+    bool lineStart = true;
+    char line[64];
+    while (true)
+    {
+        size_t length = client->readBytesUntil('\n', line, sizeof(line) - 1);
+        if (length == 0 && !client->connected() && !client->available())
+        {
+#ifdef TWEESP32_SERIAL_OUTPUT
+            Serial.println(F("Invalid response"));
+#endif
+            return false;
+        }
+        line[length] = '\0';
+
+        // Long lines come back in pieces, only the start of a line is a header name
+        bool fullLine = length < sizeof(line) - 1;
+        if (lineStart)
+        {
+            if (length == 0 || (length == 1 && line[0] == '\r'))
+            {
+                break;
+            }
+
+            if (strncasecmp(line, "Content-Encoding:", 17) == 0 && strstr(line + 17, "gzip") != NULL)
+            {
+                gzipped = true;
+            }
+            else if (strncasecmp(line, "Retry-After:", 12) == 0)
+            {
+                context.error.retryAfter = strtoul(line + 12, NULL, 10);
+            }
+            else if (strncasecmp(line, "x-rate-limit-reset:", 19) == 0)
+            {
+                context.rateLimitReset = strtoul(line + 19, NULL, 10);
+                context.error.rateLimitReset = context.rateLimitReset;
+            }
+            else if (strncasecmp(line, "x-rate-limit-remaining:", 23) == 0)
+            {
+                context.rateLimitRemaining = atoi(line + 23);
+            }
+        }
+        lineStart = fullLine;
+    }
+
+#ifdef TWEESP32_DEBUG
+    Serial.print(F("gzip response: "));
+    Serial.println(gzipped);
+#endif
+
+    if (!gzipped)
     {
         // Was getting stray characters between the headers and the body
         // This should toss them away
@@ -670,19 +1480,28 @@ void TweESP32::skipHeaders(bool tossUnexpectedForJSON)
 #endif
         }
     }
+
+    return gzipped;
 }
 
-int TweESP32::getHttpStatusCode()
+int TweESP32::getHttpStatusCode(Client *client)
 {
+    // Read the whole line, the "\r\n" included, so the headers start at the next one
     char status[32] = {0};
-    client->readBytesUntil('\r', status, sizeof(status));
+    size_t length = client->readBytesUntil('\n', status, sizeof(status) - 1);
+    if (length == sizeof(status) - 1)
+    {
+        // A long reason phrase, only the code is needed
+        client->find("\n");
+    }
 #ifdef TWEESP32_DEBUG
     Serial.print(F("Status: "));
     Serial.println(status);
 #endif
 
     char *token;
-    token = strtok(status, " "); // https://www.tutorialspoint.com/c_standard_library/c_function_strtok.htm
+    char *savePtr;
+    token = strtok_r(status, " ", &savePtr); // https://www.tutorialspoint.com/c_standard_library/c_function_strtok.htm
 
 #ifdef TWEESP32_DEBUG
     Serial.print(F("HTTP Version: "));
@@ -691,7 +1510,7 @@ int TweESP32::getHttpStatusCode()
 
     if (token != NULL && (strcmp(token, "HTTP/1.0") == 0 || strcmp(token, "HTTP/1.1") == 0))
     {
-        token = strtok(NULL, " ");
+        token = strtok_r(NULL, " ", &savePtr);
         if (token != NULL)
         {
 #ifdef TWEESP32_DEBUG
@@ -705,22 +1524,219 @@ int TweESP32::getHttpStatusCode()
     return -1;
 }
 
-void TweESP32::parseError()
+void TweESP32::parseError(Stream *body, int statusCode, TweESP32Error &error)
 {
-    //This method doesn't currently do anything other than print
+    error.httpStatus = statusCode;
+
+    if (statusCode > 0)
+    {
+        // Only keep what goes into TweESP32Error, so a small fixed document is enough
+        StaticJsonDocument<128> filter;
+        filter["title"] = true;
+        filter["detail"] = true;
+        filter["errors"][0]["code"] = true;
+        filter["errors"][0]["message"] = true;
+
+        StaticJsonDocument<512> doc;
+        DeserializationError parseResult = deserializeJson(doc, *body, DeserializationOption::Filter(filter));
+
+        // Running out of room still leaves whatever was parsed before that
+        if (!parseResult || parseResult == DeserializationError::NoMemory)
+        {
+            // v2 errors have a title & detail, v1.1 (media upload) only has a list of errors
+            const char *title = doc["title"] | doc["errors"][0]["message"].as<const char *>();
+            copyErrorText(error.title, title, sizeof(error.title));
+            copyErrorText(error.detail, doc["detail"].as<const char *>(), sizeof(error.detail));
+            error.code = doc["errors"][0]["code"] | 0;
+        }
+    }
+
+    // 429 responses might only say when the rate limit resets
+    if (statusCode == 429 && error.retryAfter == 0 && error.rateLimitReset != 0)
+    {
+        // Not worth holding up the request waiting for the clock to be set
+        unsigned long now = getEpoch(0);
+        if (now != 0 && error.rateLimitReset > now)
+        {
+            error.retryAfter = error.rateLimitReset - now;
+        }
+    }
+
+    // No response, rate limited or a problem on Twitter's side are worth
+    // trying again, anything else will fail the same way next time.
+    // 88 = Rate limit exceeded, 130 = Over capacity, 131 = Internal error
+    error.retryable = statusCode <= 0 ||
+                      statusCode == 429 ||
+                      statusCode >= 500 ||
+                      error.code == 88 || error.code == 130 || error.code == 131;
+
 #ifdef TWEESP32_SERIAL_OUTPUT
-    DynamicJsonDocument doc(1000);
-    DeserializationError error = deserializeJson(doc, *client);
-    if (!error)
+    Serial.print(F("Request failed, status: "));
+    Serial.print(statusCode);
+    if (error.code != 0)
     {
-        Serial.print(F("getAuthToken error"));
-        serializeJson(doc, Serial);
+        Serial.print(F(" code: "));
+        Serial.print(error.code);
     }
-    else
+    Serial.print(F(" "));
+    Serial.print(error.title);
+    Serial.print(F(" "));
+    Serial.println(error.detail);
+#endif
+}
+
+// For failures that happen on this side, so there is no response to parse
+void TweESP32::setLocalError(TweESP32Error &error, int status, const char *title, bool retryable)
+{
+    error = TweESP32Error();
+    error.httpStatus = status;
+    copyErrorText(error.title, title, sizeof(error.title));
+    error.retryable = retryable;
+}
+
+void TweESP32::setInvalidTweetError(TweESP32Error &error, const char *title, int status)
+{
+    setLocalError(error, status, title, false);
+}
+
+void TweESP32::setDeadlineError(TweESP32Error &error)
+{
+    setLocalError(error, TWEESP32_DEADLINE_EXCEEDED, "Deadline exceeded", true);
+}
+
+void TweESP32::finishRequest(TweESP32Context &context, DeadlineClient &requestClient, bool success)
+{
+    context.timeRemaining = requestClient.remaining();
+    if (!success && requestClient.expired())
+    {
+#ifdef TWEESP32_SERIAL_OUTPUT
+        Serial.println(F("Request ran out of time"));
+#endif
+        setDeadlineError(context.error);
+    }
+}
+
+bool TweESP32::setClientPool(Client **clients, int numClients)
+{
+    if (clients == NULL || numClients <= 0)
+    {
+#ifdef TWEESP32_SERIAL_OUTPUT
+        Serial.println(F("Client pool needs at least one client"));
+#endif
+        return false;
+    }
+
+    if (numClients > TWEESP32_MAX_CLIENTS)
     {
-        Serial.print(F("Could not parse error"));
+        numClients = TWEESP32_MAX_CLIENTS;
     }
+
+    for (int i = 0; i < numClients; i++)
+    {
+        // The raw request methods would share it with pooled requests
+        if (clients[i] == NULL || clients[i] == client)
+        {
+#ifdef TWEESP32_SERIAL_OUTPUT
+            Serial.println(F("Client pool can't include NULL or the client passed to the constructor"));
+#endif
+            return false;
+        }
+    }
+
+    // Tasks could be waiting on the semaphore that is about to be replaced
+    if (_connectionsAvailable != NULL)
+    {
+        xSemaphoreTake(_connectionsLock, portMAX_DELAY);
+        bool inUse = uxSemaphoreGetCount(_connectionsAvailable) != (UBaseType_t)_numConnections;
+        xSemaphoreGive(_connectionsLock);
+        if (inUse)
+        {
+#ifdef TWEESP32_SERIAL_OUTPUT
+            Serial.println(F("Can't change the client pool while it is in use"));
 #endif
+            return false;
+        }
+    }
+
+    for (int i = 0; i < numClients; i++)
+    {
+        _connections[i].client = clients[i];
+        _connections[i].inUse = false;
+    }
+    _numConnections = numClients;
+    _nextConnection = 0;
+
+    if (_connectionsLock == NULL)
+    {
+        _connectionsLock = xSemaphoreCreateMutex();
+    }
+    if (_connectionsAvailable != NULL)
+    {
+        vSemaphoreDelete(_connectionsAvailable);
+    }
+    _connectionsAvailable = xSemaphoreCreateCounting(numClients, numClients);
+    return true;
+}
+
+TweESP32Connection *TweESP32::acquireConnection(unsigned long timeout, unsigned long startTime)
+{
+    // Without a pool there is only the one client, same as it always was
+    if (_connectionsAvailable == NULL)
+    {
+        return &_connections[0];
+    }
+
+    // Only wait for what is left of the request's timeout, signing it may
+    // already have used some
+    TickType_t wait = portMAX_DELAY;
+    if (timeout != 0)
+    {
+        unsigned long elapsed = millis() - startTime;
+        if (elapsed >= timeout)
+        {
+            return NULL;
+        }
+        wait = pdMS_TO_TICKS(timeout - elapsed);
+    }
+
+    // Tasks waiting on a semaphore are woken in priority order, and first come
+    // first served for the same priority, so no request gets starved
+    if (xSemaphoreTake(_connectionsAvailable, wait) != pdTRUE)
+    {
+        return NULL;
+    }
+
+    xSemaphoreTake(_connectionsLock, portMAX_DELAY);
+    TweESP32Connection *connection = NULL;
+    for (int i = 0; i < _numConnections; i++)
+    {
+        // Round robin so the connections are used evenly
+        int index = (_nextConnection + i) % _numConnections;
+        if (!_connections[index].inUse)
+        {
+            connection = &_connections[index];
+            connection->inUse = true;
+            _nextConnection = (index + 1) % _numConnections;
+            break;
+        }
+    }
+    xSemaphoreGive(_connectionsLock);
+
+    return connection;
+}
+
+void TweESP32::releaseConnection(TweESP32Connection *connection)
+{
+    if (_connectionsAvailable == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(_connectionsLock, portMAX_DELAY);
+    connection->inUse = false;
+    xSemaphoreGive(_connectionsLock);
+
+    xSemaphoreGive(_connectionsAvailable);
 }
 
 void TweESP32::setBearerToken(const char *bearerToken)
@@ -728,6 +1744,11 @@ void TweESP32::setBearerToken(const char *bearerToken)
     this->_bearerToken = bearerToken;
 }
 
+void TweESP32::setTlsSessionCache(TlsSessionCache *tlsSessionCache)
+{
+    this->_tlsSessionCache = tlsSessionCache;
+}
+
 void TweESP32::lateInit(const char *consumerKey, const char *consumerSecret, const char *accessToken, const char *accessTokenSecret)
 {
     this->_consumerKey = consumerKey;
@@ -737,7 +1758,7 @@ void TweESP32::lateInit(const char *consumerKey, const char *consumerSecret, con
     updateSigningKey();
 }
 
-void TweESP32::closeClient()
+void TweESP32::closeClient(Client *client)
 {
     //     if (client->connected())
     //     {
@@ -42,10 +42,18 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 #include <UrlEncode.h>
 
 #include "time.h"
+#include <atomic>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 #include "mbedtls/md.h"
 #include "mbedtls/base64.h"
 
+#include "GzipStream.h"
+#include "DeadlineClient.h"
+#include "TweetText.h"
+
 #ifdef TWEESP32_PRINT_JSON_PARSE
 #include <StreamUtils.h>
 #endif
@@ -57,13 +65,75 @@ Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
 
 #define TWEESP32_TIMEOUT 2000
 
+// Max number of clients that can be passed to setClientPool
+#define TWEESP32_MAX_CLIENTS 4
+
 #define TWEESP32_NONCE_LENGTH 32
 #define TWEESP32_SIGNING_KEY_LENGTH 120
 
 #define TWEESP32_TWEET_ID_LENGTH 30
 
+// Twitter's are around 45 characters
+#define TWEESP32_NEXT_TOKEN_LENGTH 64
+
+// httpStatus of a TweESP32Error when the request ran out of time
+#define TWEESP32_DEADLINE_EXCEEDED -3
+
+// httpStatus of a TweESP32Error when the tweet was rejected before sending
+// it (too long, or not valid UTF-8)
+#define TWEESP32_INVALID_TWEET -4
+
+// httpStatus of a TweESP32Error when the tweet is short enough for Twitter
+// but takes more than TWEESP32_MAX_TWEET_BYTES
+#define TWEESP32_TWEET_TOO_LARGE -5
+
+// httpStatus of a TweESP32Error when a successful response couldn't be
+// parsed (e.g. it was cut off) or was missing what was asked for
+#define TWEESP32_INVALID_RESPONSE -6
+
+// httpStatus of a TweESP32Error when the OAuth signature couldn't be made
+#define TWEESP32_SIGNING_FAILED -7
+
+// httpStatus of a TweESP32Error when the media Stream ran out before
+// mediaLength bytes were read from it
+#define TWEESP32_MEDIA_READ_FAILED -8
+
+// httpStatus of a TweESP32Error when uploadMedia's mediaType is empty or
+// not shorter than TWEESP32_MEDIA_TYPE_LENGTH
+#define TWEESP32_INVALID_MEDIA_TYPE -9
+
+#define TWEESP32_ERROR_TITLE_LENGTH 64
+#define TWEESP32_ERROR_DETAIL_LENGTH 128
+
+#define TWEESP32_AUTH_LENGTH 900
+// Big enough for a tweet of TWEESP32_MAX_TWEET_BYTES plus a reply and media ID,
+// and for a search path with a since_id and pagination token
+#define TWEESP32_REQUEST_LENGTH (TWEESP32_MAX_TWEET_BYTES + 180)
+
 #define TWEESP32_TWEETS_ENDPOINT "/2/tweets"
 
+// Media uploads still go through the v1.1 API on a different host
+#define TWEESP32_UPLOAD_HOST "upload.twitter.com"
+#define TWEESP32_MEDIA_UPLOAD_ENDPOINT "/1.1/media/upload.json"
+
+#define TWEESP32_MEDIA_ID_LENGTH 30
+
+// Longer than any type Twitter takes, e.g. "image/jpeg" or "video/mp4"
+#define TWEESP32_MEDIA_TYPE_LENGTH 32
+
+// Media is copied from the source Stream to the client through a buffer
+// of this size, so the whole file never needs to be in memory
+#define TWEESP32_MEDIA_CHUNK_SIZE 1024
+
+#define TWEESP32_MULTIPART_BOUNDARY "TweESP32MediaBoundary"
+
+// Extra tweet fields that can be requested with setSearchTweetFields
+#define TWEESP32_TWEET_FIELD_CREATED_AT 0x01
+#define TWEESP32_TWEET_FIELD_CONVERSATION_ID 0x02
+#define TWEESP32_TWEET_FIELD_PUBLIC_METRICS 0x04
+
+#define TWEESP32_TWEET_FIELDS_PARAMS_LENGTH 80
+
 struct TweetSearchResult
 {
   const char *authorId;
@@ -71,52 +141,198 @@ struct TweetSearchResult
   const char *text;
   const char *name;
   const char *username;
+
+  // Only populated if requested with setSearchTweetFields
+  const char *createdAt;
+  const char *conversationId;
+  int retweetCount;
+  int replyCount;
+  int likeCount;
+  int quoteCount;
 };
 
 typedef bool (*processTweetSearch)(TweetSearchResult result, int index, int numResults);
 
+struct TweESP32Connection
+{
+  Client *client;
+  bool inUse;
+};
+
+// Details of why the last request failed, everything is 0/empty if it succeeded
+struct TweESP32Error
+{
+  int httpStatus; // -1/-2 if the request never got a response, otherwise one of the TWEESP32_* statuses above if it failed before or after the request
+  int code;       // Twitter's error code, if it sent one
+  char title[TWEESP32_ERROR_TITLE_LENGTH];
+  char detail[TWEESP32_ERROR_DETAIL_LENGTH];
+
+  unsigned long retryAfter;     // Seconds to wait before trying again, 0 if not given
+  unsigned long rateLimitReset; // Epoch time the rate limit resets, 0 if not given
+
+  // True if the same request could work if tried again (e.g. rate limited or
+  // a server error), false if it will keep failing (e.g. bad auth or tweet)
+  bool retryable;
+};
+
+// Holds everything that changes during a request. The TweESP32 object itself
+// only holds the credentials, so each task can pass in its own context and
+// call the library at the same time as the others (see setClientPool).
+class TweetStore;
+
+struct TweESP32Context
+{
+  // Max time in ms the whole call (connecting, sending and parsing) can take,
+  // 0 for no limit. Each step still times out after TWEESP32_TIMEOUT.
+  unsigned long timeout = 0;
+
+  // Time in ms that was left of the timeout when the call finished
+  unsigned long timeRemaining = 0;
+
+  char nonce[TWEESP32_NONCE_LENGTH + 1];
+  char auth[TWEESP32_AUTH_LENGTH];
+
+  // The body of a tweet, or the path of a search
+  char request[TWEESP32_REQUEST_LENGTH];
+
+  // Set to the ID of the tweet after a successful sendTweet, or the newest
+  // tweet found by searchTweets (empty if it found nothing)
+  char tweetId[TWEESP32_TWEET_ID_LENGTH];
+
+  // Set by searchTweets when there are more results than came back in one
+  // response, pass it as the paginationToken to get the next page (empty
+  // once there are no more)
+  char nextToken[TWEESP32_NEXT_TOKEN_LENGTH];
+
+  // From the last response that included them, -1/0 if not known yet
+  int rateLimitRemaining = -1;
+  unsigned long rateLimitReset = 0; // Epoch time
+
+  TweESP32Error error;
+
+  // If set, searchTweets copies the tweets it finds into this store (oldest
+  // first, so get(0) is the newest). The callback can then be NULL.
+  TweetStore *store = NULL;
+};
+
+// Implement this for a Client that can resume TLS sessions and pass it to
+// setTlsSessionCache, so reconnecting to the same host can skip the full handshake.
+// When using setClientPool these can be called from more than one task at a time.
+class TlsSessionCache
+{
+public:
+  // Called before connecting, give the client the saved session for this host.
+  // Return true if a session was applied.
+  virtual bool apply(Client &client, const char *host) = 0;
+
+  // Called after a successful connection, store the client's session for next time.
+  // Return true if this connection resumed the saved session.
+  virtual bool save(Client &client, const char *host) = 0;
+
+  // Called when connecting with a saved session failed. Return true only if
+  // the server was reached and rejected the session (e.g. it had expired),
+  // then the session is cleared and a full handshake is tried. Anything else
+  // (no WiFi, DNS, TCP) would just fail again, so by default it doesn't retry.
+  virtual bool sessionRejected(Client &client, const char *host) { return false; }
+
+  // Drop the saved session for this host
+  virtual void clear(const char *host) = 0;
+};
+
 class TweESP32
 {
 public:
   TweESP32(Client &client);
   TweESP32(Client &client, const char *consumerKey, const char *consumerSecret, const char *accessToken, const char *accessTokenSecret, const char *bearerToken = NULL);
   TweESP32(Client &client, const char *bearerToken);
+  ~TweESP32();
 
   // Auth Methods
   void updateSigningKey();
-  void updateNonce();
-  bool calculateSignature(const char *method, const char *url, unsigned long time, const char *queryParams, const char *bodyParams, char *out_sig);
-  unsigned long getEpoch();
-  void generateAuthHeader(unsigned long time, char *sig, char *outAuth);
+  void updateNonce(char *nonce = NULL);
+  bool calculateSignature(const char *method, const char *url, unsigned long time, const char *queryParams, const char *bodyParams, char *out_sig, const char *nonce = NULL);
+  // 0 if the clock hasn't been set by timeConfig, waiting up to wait ms for it
+  unsigned long getEpoch(uint32_t wait = 5000);
+  void generateAuthHeader(unsigned long time, char *sig, char *outAuth, const char *nonce = NULL);
+  bool generateOAuthHeader(const char *method, const char *url, const char *queryParams, const char *bodyParams, char *outAuth, char *nonce = NULL);
   void timeConfig();
 
   // Generic Request Methods
-  int makeGetRequest(const char *command, const char *authorization, const char *accept = "application/json", const char *host = TWEESP32_HOST);
+  int makeGetRequest(const char *command, const char *authorization, const char *accept = "application/json", const char *host = TWEESP32_HOST, bool acceptGzip = false);
   int makeRequestWithBody(const char *type, const char *command, const char *authorization, const char *body = "", const char *contentType = "application/json", const char *host = TWEESP32_HOST);
   int makePostRequest(const char *command, const char *authorization, const char *body = "", const char *contentType = "application/json", const char *host = TWEESP32_HOST);
   int makePutRequest(const char *command, const char *authorization, const char *body = "", const char *contentType = "application/json", const char *host = TWEESP32_HOST);
 
   // User methods
-  bool sendTweet(char *message, char *replyTo = NULL);
+  bool sendTweet(char *message, char *replyTo = NULL, const char *mediaId = NULL);
+  bool sendTweet(TweESP32Context &context, char *message, char *replyTo = NULL, const char *mediaId = NULL);
+
+  // Splits a message that is too long for one tweet at words and sends it as
+  // a thread, each part ending with its number (e.g. " 2/3"). Returns the
+  // number of tweets sent, the ID of the last one is in lastTweetId/context.tweetId.
+  int sendTweetThread(char *message, char *replyTo = NULL);
+  int sendTweetThread(TweESP32Context &context, char *message, char *replyTo = NULL);
   int searchTweets(processTweetSearch searchCallback, char *query, bool includeUsername = true, char *since_id = NULL);
+  int searchTweets(TweESP32Context &context, processTweetSearch searchCallback, char *query, bool includeUsername = true, char *since_id = NULL, const char *paginationToken = NULL);
+  void setSearchTweetFields(uint8_t tweetFields);
+
+  // Media methods
+  bool uploadMedia(Stream &media, size_t mediaLength, const char *mediaType, char *outMediaId);
+  bool uploadMedia(TweESP32Context &context, Stream &media, size_t mediaLength, const char *mediaType, char *outMediaId);
 
   int portNumber = 443;
 
   char lastTweetId[TWEESP32_TWEET_ID_LENGTH];
 
+  // Why the last call that didn't take a context failed
+  TweESP32Error lastError = {};
+
   const char *ntpServer = "pool.ntp.org";
 
   int searchWithNameBufferSize = 4500;
 
+  // Asks for search results to be gzipped and inflates them while parsing.
+  // Uses less bandwidth but needs ~43KB of free heap during the search.
+  bool useGzip = false;
+
+  // sendTweet normally fails with TWEESP32_INVALID_TWEET (or
+  // TWEESP32_TWEET_TOO_LARGE) if the message is too long, set this to send
+  // as much of it as fits instead
+  bool truncateLongTweets = false;
+
+  // Max bytes sent per APPEND request of a media upload (Twitter allows up to 5MB)
+  size_t mediaSegmentSize = 1024 * 1024;
+
+  // Where media uploads are sent (and signed for), e.g. a local server while testing
+  const char *uploadHost = TWEESP32_UPLOAD_HOST;
+
   Client *client;
   void lateInit(const char *consumerKey, const char *consumerSecret, const char *accessToken, const char *accessTokenSecret);
   void setBearerToken(const char *bearerToken);
+  void setTlsSessionCache(TlsSessionCache *tlsSessionCache);
+
+  // Lets sendTweet, searchTweets and uploadMedia be called from different
+  // FreeRTOS tasks at the same time, each request uses its own client from
+  // the pool (waiting for one to be free if needed). Each task must use
+  // the versions of those methods that take its own TweESP32Context.
+  //
+  // The client given to the constructor can't be in the pool, it is kept for
+  // makeGetRequest/makePostRequest etc. which leave the response for you to
+  // read. Set the pool before starting the tasks that use the library,
+  // returns false (and changes nothing) if a request is using the pool.
+  bool setClientPool(Client **clients, int numClients);
+
+  // How many connections needed a full TLS handshake vs resumed a saved session.
+  // Atomic as pooled requests connect from more than one task.
+  std::atomic<int> fullHandshakes{0};
+  std::atomic<int> resumedHandshakes{0};
 
 #ifdef TWEESP32_DEBUG
   char *stack_start;
 #endif
 
 private:
+  // Only used by the auth methods above when they are not given a nonce
   char _nonce[TWEESP32_NONCE_LENGTH + 1];
   char _signingKey[TWEESP32_SIGNING_KEY_LENGTH];
   const char *_consumerKey;
@@ -124,17 +340,53 @@ private:
   const char *_accessToken;
   const char *_accessTokenSecret;
   const char *_bearerToken;
+  TlsSessionCache *_tlsSessionCache = NULL;
+
+  // Used by the methods that don't take a context, so those are not safe to
+  // call from more than one task at a time
+  TweESP32Context _defaultContext;
+
+  TweESP32Connection _connections[TWEESP32_MAX_CLIENTS] = {};
+  int _numConnections = 1;
+  int _nextConnection = 0;
+  SemaphoreHandle_t _connectionsAvailable = NULL;
+  SemaphoreHandle_t _connectionsLock = NULL;
+
+  // NULL if none became free before timeout ms (0 for no limit) from startTime
+  TweESP32Connection *acquireConnection(unsigned long timeout, unsigned long startTime);
+  void releaseConnection(TweESP32Connection *connection);
 
   const char *searchEndpointAndParams =
       R"(/2/tweets/search/recent?max_results=10&query=%s)";
   const char *searchIncludeNameParams =
       R"(&expansions=author_id&user.fields=username)";
 
-  int getContentLength();
-  int getHttpStatusCode();
-  void skipHeaders(bool tossUnexpectedForJSON = true);
-  void closeClient();
-  void parseError();
+  // Built once by setSearchTweetFields, so only the fields that are
+  // used get stored when parsing the search results
+  char _searchTweetFieldsParams[TWEESP32_TWEET_FIELDS_PARAMS_LENGTH];
+  StaticJsonDocument<384> _searchFilter;
+
+  int makeGetRequest(DeadlineClient *client, const char *command, const char *authorization, const char *accept = "application/json", const char *host = TWEESP32_HOST, bool acceptGzip = false);
+  int makeRequestWithBody(DeadlineClient *client, const char *type, const char *command, const char *authorization, const char *body = "", const char *contentType = "application/json", const char *host = TWEESP32_HOST);
+  bool connectClient(DeadlineClient *requestClient, const char *host);
+  int sendRequestHeaders(DeadlineClient *client, const char *type, const char *command, const char *authorization, const char *contentType, size_t contentLength, const char *host);
+  bool streamToClient(Client *client, Stream &source, size_t length, TweESP32Error &error);
+  bool signMediaUpload(TweESP32Context &context, const char *bodyParams);
+  bool initMediaUpload(DeadlineClient *client, TweESP32Context &context, size_t mediaLength, const char *mediaType, char *outMediaId);
+  bool appendMedia(DeadlineClient *client, TweESP32Context &context, Stream &media, const char *mediaId, int segmentIndex, size_t segmentLength);
+  bool finalizeMediaUpload(DeadlineClient *client, TweESP32Context &context, const char *mediaId);
+  bool parseMediaId(Client *client, char *outMediaId, TweESP32Error &error);
+
+  int getContentLength(Client *client);
+  int getHttpStatusCode(Client *client);
+  bool readHeaders(Client *client, TweESP32Context &context);
+  void closeClient(Client *client);
+  void parseError(Stream *body, int statusCode, TweESP32Error &error);
+  TweetSearchResult getSearchResult(JsonDocument &doc, int i, int resultCount, bool includeUsername);
+  void setLocalError(TweESP32Error &error, int status, const char *title, bool retryable);
+  void setDeadlineError(TweESP32Error &error);
+  void setInvalidTweetError(TweESP32Error &error, const char *title, int status = TWEESP32_INVALID_TWEET);
+  void finishRequest(TweESP32Context &context, DeadlineClient &requestClient, bool success);
 #ifdef TWEESP32_DEBUG
   void printStack();
 #endif
@@ -0,0 +1,156 @@
+/*
+TweESP32 - A Twitter API library for the ESP32 that can tweet
+
+Copyright (c) 2022  Brian Lough.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "TweetPoller.h"
+
+TweetPoller::TweetPoller(TweESP32 &twitter, unsigned long minInterval, unsigned long maxInterval)
+{
+    _twitter = &twitter;
+    this->minInterval = minInterval;
+    this->maxInterval = maxInterval;
+    interval = minInterval;
+}
+
+int TweetPoller::poll(processTweetSearch searchCallback, char *query, bool includeUsername)
+{
+    _lastPoll = millis();
+    _havePolled = true;
+
+    // Each page comes back newest first, so _sinceId can only move on to the
+    // newest once every page has been fetched, otherwise the older tweets of
+    // a burst would be skipped
+    char *sinceId = _sinceId[0] != '\0' ? _sinceId : NULL;
+    int resultNum = 0;
+    int pages = 0;
+    do
+    {
+        bool firstPage = _nextToken[0] == '\0';
+        int pageResults = _twitter->searchTweets(context, searchCallback, query, includeUsername, sinceId, firstPage ? NULL : _nextToken);
+        if (pageResults < 0)
+        {
+            // Picks up from this page next time, unless it will keep failing
+            // (e.g. the token expired), then the rest of the pages are skipped
+            if (!firstPage && !context.error.retryable)
+            {
+                _nextToken[0] = '\0';
+            }
+            resultNum = pageResults;
+            break;
+        }
+
+        if (firstPage && context.tweetId[0] != '\0')
+        {
+            strcpy(_newestId, context.tweetId);
+        }
+        strcpy(_nextToken, context.nextToken);
+        resultNum += pageResults;
+        pages++;
+    } while (_nextToken[0] != '\0' && pages < maxPagesPerPoll && context.rateLimitRemaining != 0);
+
+    if (_nextToken[0] == '\0' && _newestId[0] != '\0')
+    {
+        strcpy(_sinceId, _newestId);
+        _newestId[0] = '\0';
+    }
+
+    if (resultNum > 0)
+    {
+        // Tweets are turning up, check back sooner
+        interval /= 2;
+    }
+    else if (resultNum == 0 || context.error.retryable)
+    {
+        interval *= 2;
+    }
+    else
+    {
+        // Trying again won't help (bad query, bad token etc.)
+        interval = maxInterval;
+    }
+
+    if (interval < minInterval)
+    {
+        interval = minInterval;
+    }
+    if (interval > maxInterval)
+    {
+        interval = maxInterval;
+    }
+
+    // These can go past maxInterval, as polling sooner would just fail.
+    // The next poll is likely to need as many requests as this one did
+    unsigned long rateLimitWait = rateLimitInterval() * (pages > 1 ? pages : 1);
+    if (interval < rateLimitWait)
+    {
+        interval = rateLimitWait;
+    }
+
+    if (resultNum < 0 && interval < context.error.retryAfter * 1000)
+    {
+        interval = context.error.retryAfter * 1000;
+    }
+
+#ifdef TWEESP32_DEBUG
+    Serial.print(F("Next poll in: "));
+    Serial.println(interval);
+#endif
+
+    return resultNum;
+}
+
+bool TweetPoller::isDue()
+{
+    return !_havePolled || millis() - _lastPoll >= interval;
+}
+
+unsigned long TweetPoller::nextPollTime()
+{
+    return _lastPoll + interval;
+}
+
+unsigned long TweetPoller::timeUntilNextPoll()
+{
+    if (isDue())
+    {
+        return 0;
+    }
+
+    return interval - (millis() - _lastPoll);
+}
+
+unsigned long TweetPoller::rateLimitInterval()
+{
+    if (context.rateLimitRemaining < 0 || context.rateLimitReset == 0)
+    {
+        return 0;
+    }
+
+    // 0 if the clock hasn't been set by timeConfig, don't wait for it
+    // as that would hold up every poll
+    unsigned long now = _twitter->getEpoch(0);
+    if (now == 0 || context.rateLimitReset <= now)
+    {
+        return 0;
+    }
+
+    // Share what's left of the rate limit evenly until it resets
+    unsigned long untilReset = (context.rateLimitReset - now) * 1000;
+    return untilReset / (context.rateLimitRemaining + 1);
+}
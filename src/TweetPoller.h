@@ -0,0 +1,77 @@
+/*
+TweESP32 - A Twitter API library for the ESP32 that can tweet
+
+Copyright (c) 2022  Brian Lough.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef TweetPoller_h
+#define TweetPoller_h
+
+#include "TweESP32.h"
+
+// Polls a search, checking more often while new tweets are turning up and
+// backing off (doubling the interval) while nothing is happening. It also
+// spreads requests out so the rate limit isn't used up before it resets.
+//
+// Between polls the device is free to sleep until nextPollTime().
+class TweetPoller
+{
+public:
+  TweetPoller(TweESP32 &twitter, unsigned long minInterval = 15000, unsigned long maxInterval = 900000);
+
+  // Runs the search (only returning tweets newer than the last poll)
+  // and works out when the next one should be. If more tweets turned up
+  // than fit in one page of results, it keeps fetching pages until it has
+  // them all, up to maxPagesPerPoll. Returns the number of tweets found, or
+  // the same as searchTweets if a search failed.
+  int poll(processTweetSearch searchCallback, char *query, bool includeUsername = true);
+
+  bool isDue();
+
+  // millis() value when the next poll is due
+  unsigned long nextPollTime();
+  unsigned long timeUntilNextPoll();
+
+  // Bounds for the time between polls (in ms)
+  unsigned long minInterval;
+  unsigned long maxInterval;
+
+  // Current time between polls (in ms)
+  unsigned long interval;
+
+  // Each page is a request against the rate limit. Pages left over are
+  // fetched by the next poll, which won't skip past them
+  int maxPagesPerPoll = 10;
+
+  // Used for every search, so you can set a timeout or check the error
+  TweESP32Context context;
+
+private:
+  TweESP32 *_twitter;
+  unsigned long _lastPoll = 0;
+  bool _havePolled = false;
+  char _sinceId[TWEESP32_TWEET_ID_LENGTH] = "";
+
+  // While working through the pages of a burst: the newest ID (from its
+  // first page) and the page to fetch next
+  char _newestId[TWEESP32_TWEET_ID_LENGTH] = "";
+  char _nextToken[TWEESP32_NEXT_TOKEN_LENGTH] = "";
+
+  unsigned long rateLimitInterval();
+};
+
+#endif
@@ -0,0 +1,306 @@
+/*
+TweESP32 - A Twitter API library for the ESP32 that can tweet
+
+Copyright (c) 2022  Brian Lough.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+
+#include "TweetStore.h"
+
+TweetStore::TweetStore(int capacity, size_t poolSize)
+{
+    if (poolSize > TWEETSTORE_MAX_POOL_SIZE)
+    {
+        poolSize = TWEETSTORE_MAX_POOL_SIZE;
+    }
+
+    _tweets = (StoredTweet *)malloc(capacity * sizeof(StoredTweet));
+    _pool = (char *)malloc(poolSize);
+
+    if (_tweets == NULL || _pool == NULL)
+    {
+#ifdef TWEESP32_SERIAL_OUTPUT
+        Serial.println(F("Not enough memory for TweetStore"));
+#endif
+        free(_tweets);
+        free(_pool);
+        _tweets = NULL;
+        _pool = NULL;
+        capacity = 0;
+        poolSize = 0;
+    }
+
+    _capacity = capacity;
+    _poolSize = poolSize;
+}
+
+TweetStore::~TweetStore()
+{
+    free(_tweets);
+    free(_pool);
+}
+
+static size_t storedLength(const char *value)
+{
+    return (value == NULL) ? 0 : strlen(value) + 1;
+}
+
+TweetHandle TweetStore::add(const TweetSearchResult &tweet)
+{
+    if (_capacity == 0)
+    {
+        return 0;
+    }
+
+    // Worst case, nothing can be shared with the tweets already stored
+    size_t needed = storedLength(tweet.authorId) + storedLength(tweet.tweetId) + storedLength(tweet.text) + storedLength(tweet.name) + storedLength(tweet.username) + storedLength(tweet.createdAt) + storedLength(tweet.conversationId);
+    if (needed > _poolSize)
+    {
+#ifdef TWEESP32_DEBUG
+        Serial.println(F("Tweet is too big for the TweetStore pool"));
+#endif
+        return 0;
+    }
+
+    if (_count == _capacity)
+    {
+        dropOldest();
+    }
+
+    if (_poolUsed + needed > _poolSize)
+    {
+        compact();
+        while (_poolUsed + needed > _poolSize && _count > 0)
+        {
+            dropOldest();
+            compact();
+        }
+    }
+
+    StoredTweet stored;
+    stored.authorId = internString(tweet.authorId, &StoredTweet::authorId);
+    stored.tweetId = storeString(tweet.tweetId);
+    stored.text = storeString(tweet.text);
+    stored.name = internString(tweet.name, &StoredTweet::name);
+    stored.username = internString(tweet.username, &StoredTweet::username);
+    stored.createdAt = storeString(tweet.createdAt);
+    stored.conversationId = internString(tweet.conversationId, &StoredTweet::conversationId);
+    stored.retweetCount = tweet.retweetCount;
+    stored.replyCount = tweet.replyCount;
+    stored.likeCount = tweet.likeCount;
+    stored.quoteCount = tweet.quoteCount;
+
+    stored.handle = _nextHandle++;
+    if (_nextHandle == 0)
+    {
+        _nextHandle = 1;
+    }
+
+    _count++;
+    storedTweet(0) = stored;
+
+    return stored.handle;
+}
+
+TweetSearchResult TweetStore::get(int index)
+{
+    TweetSearchResult result = {};
+    if (index < 0 || index >= _count)
+    {
+        return result;
+    }
+
+    StoredTweet &stored = storedTweet(index);
+    result.authorId = getString(stored.authorId);
+    result.tweetId = getString(stored.tweetId);
+    result.text = getString(stored.text);
+    result.name = getString(stored.name);
+    result.username = getString(stored.username);
+    result.createdAt = getString(stored.createdAt);
+    result.conversationId = getString(stored.conversationId);
+    result.retweetCount = stored.retweetCount;
+    result.replyCount = stored.replyCount;
+    result.likeCount = stored.likeCount;
+    result.quoteCount = stored.quoteCount;
+
+    return result;
+}
+
+TweetHandle TweetStore::handle(int index)
+{
+    if (index < 0 || index >= _count)
+    {
+        return 0;
+    }
+
+    return storedTweet(index).handle;
+}
+
+TweetSearchResult TweetStore::find(TweetHandle handle)
+{
+    return get(indexOf(handle));
+}
+
+bool TweetStore::contains(TweetHandle handle)
+{
+    return indexOf(handle) >= 0;
+}
+
+int TweetStore::count()
+{
+    return _count;
+}
+
+int TweetStore::capacity()
+{
+    return _capacity;
+}
+
+size_t TweetStore::poolUsed()
+{
+    return _poolUsed;
+}
+
+void TweetStore::clear()
+{
+    _oldest = 0;
+    _count = 0;
+    _poolUsed = 0;
+}
+
+// 0 is the newest
+TweetStore::StoredTweet &TweetStore::storedTweet(int index)
+{
+    return _tweets[(_oldest + _count - 1 - index) % _capacity];
+}
+
+// -1 if it isn't stored
+int TweetStore::indexOf(TweetHandle handle)
+{
+    for (int i = 0; i < _count && handle != 0; i++)
+    {
+        if (storedTweet(i).handle == handle)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+const char *TweetStore::getString(uint16_t offset)
+{
+    return (offset == TWEETSTORE_NO_STRING) ? NULL : _pool + offset;
+}
+
+// add() has already made sure there is room
+uint16_t TweetStore::storeString(const char *value)
+{
+    if (value == NULL)
+    {
+        return TWEETSTORE_NO_STRING;
+    }
+
+    size_t length = strlen(value) + 1;
+    uint16_t offset = _poolUsed;
+    memcpy(_pool + offset, value, length);
+    _poolUsed += length;
+
+    return offset;
+}
+
+// Reuses the string if a stored tweet already has the same value for this field
+uint16_t TweetStore::internString(const char *value, uint16_t StoredTweet::*field)
+{
+    if (value == NULL)
+    {
+        return TWEETSTORE_NO_STRING;
+    }
+
+    for (int i = 0; i < _count; i++)
+    {
+        uint16_t offset = storedTweet(i).*field;
+        if (offset != TWEETSTORE_NO_STRING && strcmp(_pool + offset, value) == 0)
+        {
+            return offset;
+        }
+    }
+
+    return storeString(value);
+}
+
+bool TweetStore::isReferenced(uint16_t offset)
+{
+    for (int i = 0; i < _count; i++)
+    {
+        StoredTweet &stored = storedTweet(i);
+        if (stored.authorId == offset || stored.tweetId == offset || stored.text == offset || stored.name == offset || stored.username == offset || stored.createdAt == offset || stored.conversationId == offset)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void TweetStore::moveReferences(uint16_t from, uint16_t to)
+{
+    for (int i = 0; i < _count; i++)
+    {
+        StoredTweet &stored = storedTweet(i);
+        uint16_t *offsets[] = {&stored.authorId, &stored.tweetId, &stored.text, &stored.name, &stored.username, &stored.createdAt, &stored.conversationId};
+        for (uint16_t *offset : offsets)
+        {
+            if (*offset == from)
+            {
+                *offset = to;
+            }
+        }
+    }
+}
+
+// Its strings are only freed by the next compact()
+void TweetStore::dropOldest()
+{
+    _oldest = (_oldest + 1) % _capacity;
+    _count--;
+}
+
+// Slides the strings still in use down to the start of the pool. They are in
+// the order they were added, so each one only ever moves towards the start
+// and never lands on an offset that hasn't been checked yet.
+void TweetStore::compact()
+{
+    size_t readOffset = 0;
+    size_t writeOffset = 0;
+    while (readOffset < _poolUsed)
+    {
+        size_t length = strlen(_pool + readOffset) + 1;
+        if (isReferenced(readOffset))
+        {
+            if (writeOffset != readOffset)
+            {
+                memmove(_pool + writeOffset, _pool + readOffset, length);
+                moveReferences(readOffset, writeOffset);
+            }
+            writeOffset += length;
+        }
+        readOffset += length;
+    }
+
+    _poolUsed = writeOffset;
+}
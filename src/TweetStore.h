@@ -0,0 +1,112 @@
+/*
+TweESP32 - A Twitter API library for the ESP32 that can tweet
+
+Copyright (c) 2022  Brian Lough.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+
+#ifndef TweetStore_h
+#define TweetStore_h
+
+#include "TweESP32.h"
+
+#define TWEETSTORE_NO_STRING 0xFFFF
+#define TWEETSTORE_MAX_POOL_SIZE 0xFFFE
+
+// Refers to the same stored tweet as newer ones are added (unlike an index).
+// 0 is never a valid handle.
+typedef uint32_t TweetHandle;
+
+// Keeps the most recent tweets from searchTweets so they can still be used
+// (e.g. redrawn on a display) after the search has returned.
+//
+// All the text is copied into one fixed size pool and repeated strings (the
+// name and username of someone who tweets a lot) are only stored once. The
+// memory is allocated when the store is created, adding a tweet never
+// allocates. Once it is full the oldest tweets are dropped to make room.
+//
+// Making room moves the text that's left around the pool, so the strings in
+// a TweetSearchResult from get() or find() are only valid until the next
+// add() (or search that fills this store). To keep referring to a tweet,
+// keep its handle and look it up again with find().
+class TweetStore
+{
+public:
+  TweetStore(int capacity = 10, size_t poolSize = 4096);
+  ~TweetStore();
+
+  // Copies the tweet into the store. Returns its handle, or 0 if it could never fit.
+  TweetHandle add(const TweetSearchResult &tweet);
+
+  // 0 is the newest tweet
+  TweetSearchResult get(int index);
+  TweetHandle handle(int index);
+
+  // The tweet is empty (tweetId is NULL) once it has been dropped
+  TweetSearchResult find(TweetHandle handle);
+  bool contains(TweetHandle handle);
+
+  int count();
+  int capacity();
+
+  // Bytes of the pool in use
+  size_t poolUsed();
+
+  void clear();
+
+private:
+  struct StoredTweet
+  {
+    // Offsets into _pool
+    uint16_t authorId;
+    uint16_t tweetId;
+    uint16_t text;
+    uint16_t name;
+    uint16_t username;
+    uint16_t createdAt;
+    uint16_t conversationId;
+
+    int retweetCount;
+    int replyCount;
+    int likeCount;
+    int quoteCount;
+
+    TweetHandle handle;
+  };
+
+  StoredTweet *_tweets;
+  int _capacity;
+  int _oldest = 0;
+  int _count = 0;
+  TweetHandle _nextHandle = 1;
+
+  char *_pool;
+  size_t _poolSize;
+  size_t _poolUsed = 0;
+
+  StoredTweet &storedTweet(int index);
+  int indexOf(TweetHandle handle);
+  const char *getString(uint16_t offset);
+  uint16_t storeString(const char *value);
+  uint16_t internString(const char *value, uint16_t StoredTweet::*field);
+  bool isReferenced(uint16_t offset);
+  void moveReferences(uint16_t from, uint16_t to);
+  void dropOldest();
+  void compact();
+};
+
+#endif
@@ -0,0 +1,395 @@
+/*
+TweESP32 - A Twitter API library for the ESP32 that can tweet
+
+Copyright (c) 2022  Brian Lough.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+
+#include "TweetText.h"
+
+struct TweetTextScanner
+{
+  const char *text;
+  size_t position;
+  bool inEmoji;            // The last character counted was an emoji
+  bool joining;            // After a zero width joiner in an emoji sequence
+  bool regionalIndicator;  // After the first half of a flag
+};
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Bytes c takes in a JSON string
+static size_t jsonLength(char c)
+{
+    switch (c)
+    {
+    case '"':
+    case '\\':
+    case '\n':
+    case '\r':
+    case '\t':
+    case '\b':
+    case '\f':
+        return 2;
+    default:
+        // Any other control character needs a \u00XX escape
+        return ((uint8_t)c < 0x20) ? 6 : 1;
+    }
+}
+
+// Returns the number of bytes in the character, or 0 if it isn't valid UTF-8
+static int decodeUtf8(const uint8_t *s, uint32_t &codePoint)
+{
+    int length;
+    uint32_t minCodePoint;
+    if (s[0] < 0x80)
+    {
+        codePoint = s[0];
+        return 1;
+    }
+    else if ((s[0] & 0xE0) == 0xC0)
+    {
+        length = 2;
+        codePoint = s[0] & 0x1F;
+        minCodePoint = 0x80;
+    }
+    else if ((s[0] & 0xF0) == 0xE0)
+    {
+        length = 3;
+        codePoint = s[0] & 0x0F;
+        minCodePoint = 0x800;
+    }
+    else if ((s[0] & 0xF8) == 0xF0)
+    {
+        length = 4;
+        codePoint = s[0] & 0x07;
+        minCodePoint = 0x10000;
+    }
+    else
+    {
+        return 0;
+    }
+
+    for (int i = 1; i < length; i++)
+    {
+        // Also stops at the end of the string
+        if ((s[i] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+        codePoint = (codePoint << 6) | (s[i] & 0x3F);
+    }
+
+    // Overlong encodings, surrogates and anything past the end of unicode
+    if (codePoint < minCodePoint || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+    {
+        return 0;
+    }
+
+    return length;
+}
+
+static bool isEmoji(uint32_t codePoint)
+{
+    return (codePoint >= 0x1F000 && codePoint <= 0x1FAFF) || (codePoint >= 0x2300 && codePoint <= 0x23FF) || (codePoint >= 0x2600 && codePoint <= 0x27BF) || (codePoint >= 0x2B00 && codePoint <= 0x2BFF);
+}
+
+// Skin tones and tag characters (used by subdivision flags)
+static bool isEmojiModifier(uint32_t codePoint)
+{
+    return (codePoint >= 0x1F3FB && codePoint <= 0x1F3FF) || (codePoint >= 0xE0020 && codePoint <= 0xE007F);
+}
+
+// Variation selectors and the keycap, these change how the previous character is shown
+static bool isCombining(uint32_t codePoint)
+{
+    return (codePoint >= 0xFE00 && codePoint <= 0xFE0F) || codePoint == 0x20E3;
+}
+
+static bool isRegionalIndicator(uint32_t codePoint)
+{
+    return codePoint >= 0x1F1E6 && codePoint <= 0x1F1FF;
+}
+
+// The ranges twitter-text counts as 1, everything else counts as 2
+static bool isLightCharacter(uint32_t codePoint)
+{
+    return codePoint <= 0x10FF || (codePoint >= 0x2000 && codePoint <= 0x200D) || (codePoint >= 0x2010 && codePoint <= 0x201F) || (codePoint >= 0x2032 && codePoint <= 0x2037);
+}
+
+// Returns the length of the link starting at position, or 0 if there isn't one
+static size_t linkLength(const char *text, size_t position)
+{
+    // Links start a word, or follow an opening bracket or quote
+    if (position > 0 && !isSpace(text[position - 1]) && strchr("([<'\"", text[position - 1]) == NULL)
+    {
+        return 0;
+    }
+
+    if (strncasecmp(text + position, "http://", 7) != 0 && strncasecmp(text + position, "https://", 8) != 0)
+    {
+        return 0;
+    }
+
+    size_t end = position;
+    while (text[end] != '\0' && !isSpace(text[end]) && (uint8_t)text[end] < 0x80)
+    {
+        end++;
+    }
+
+    // Punctuation at the end of a sentence isn't part of the link
+    while (end > position && strchr(".,;:!?'\")", text[end - 1]) != NULL)
+    {
+        end--;
+    }
+
+    return end - position;
+}
+
+// Moves past the next character (or link) and returns its weight. Returns 0
+// if it is part of the emoji before it, or -1 if it isn't valid UTF-8.
+static int nextWeight(TweetTextScanner &scanner)
+{
+    size_t length = linkLength(scanner.text, scanner.position);
+    if (length > 0)
+    {
+        scanner.position += length;
+        scanner.inEmoji = false;
+        scanner.joining = false;
+        scanner.regionalIndicator = false;
+        return TWEESP32_URL_WEIGHT;
+    }
+
+    uint32_t codePoint;
+    int bytes = decodeUtf8((const uint8_t *)scanner.text + scanner.position, codePoint);
+    if (bytes == 0)
+    {
+        return -1;
+    }
+    scanner.position += bytes;
+
+    if (scanner.joining)
+    {
+        scanner.joining = false;
+        if (isEmoji(codePoint))
+        {
+            return 0;
+        }
+    }
+
+    if (isCombining(codePoint))
+    {
+        return 0;
+    }
+
+    if (scanner.inEmoji && (codePoint == 0x200D || isEmojiModifier(codePoint)))
+    {
+        scanner.joining = (codePoint == 0x200D);
+        return 0;
+    }
+
+    if (isRegionalIndicator(codePoint))
+    {
+        // Two of these make one flag
+        scanner.inEmoji = true;
+        scanner.regionalIndicator = !scanner.regionalIndicator;
+        return scanner.regionalIndicator ? 2 : 0;
+    }
+
+    scanner.regionalIndicator = false;
+    scanner.inEmoji = isEmoji(codePoint);
+    return isLightCharacter(codePoint) ? 1 : 2;
+}
+
+int tweetWeightedLength(const char *text)
+{
+    TweetTextScanner scanner = {text, 0, false, false, false};
+    int weight = 0;
+    while (text[scanner.position] != '\0')
+    {
+        int characterWeight = nextWeight(scanner);
+        if (characterWeight < 0)
+        {
+            return -1;
+        }
+        weight += characterWeight;
+    }
+
+    return weight;
+}
+
+size_t tweetFitLength(const char *text, int maxWeight, size_t maxBytes, bool atWord)
+{
+    TweetTextScanner scanner = {text, 0, false, false, false};
+    int weight = 0;
+    size_t characterStart = 0; // Start of the last character that counted, emoji sequences included
+    size_t wordEnd = 0;        // End of the last word that was followed by a space
+    size_t jsonBytes = 0;
+    size_t fitLength;
+
+    while (true)
+    {
+        size_t start = scanner.position;
+        if (text[start] == '\0')
+        {
+            fitLength = start;
+            break;
+        }
+
+        if (isSpace(text[start]) && start > 0 && !isSpace(text[start - 1]))
+        {
+            wordEnd = start;
+        }
+
+        int characterWeight = nextWeight(scanner);
+        if (characterWeight >= 0)
+        {
+            jsonBytes += tweetJsonLength(text + start, scanner.position - start);
+        }
+
+        if (characterWeight < 0 || weight + characterWeight > maxWeight || jsonBytes > maxBytes)
+        {
+            // Don't leave part of an emoji sequence behind
+            fitLength = (characterWeight == 0) ? characterStart : start;
+
+            if (atWord && !isSpace(text[fitLength]) && wordEnd > 0 && wordEnd < fitLength)
+            {
+                fitLength = wordEnd;
+            }
+            break;
+        }
+
+        if (characterWeight > 0)
+        {
+            characterStart = start;
+        }
+        weight += characterWeight;
+    }
+
+    if (atWord)
+    {
+        while (fitLength > 0 && isSpace(text[fitLength - 1]))
+        {
+            fitLength--;
+        }
+    }
+
+    return fitLength;
+}
+
+const char *nextTweetPart(const char *text, size_t &length, int maxWeight, size_t maxBytes)
+{
+    while (isSpace(*text))
+    {
+        text++;
+    }
+
+    length = 0;
+    if (*text == '\0')
+    {
+        return NULL;
+    }
+
+    length = tweetFitLength(text, maxWeight, maxBytes, true);
+    return text;
+}
+
+int tweetPartCount(const char *text, int maxWeight, size_t maxBytes)
+{
+    if (tweetWeightedLength(text) < 0)
+    {
+        return -1;
+    }
+
+    int parts = 0;
+    size_t length;
+    while ((text = nextTweetPart(text, length, maxWeight, maxBytes)) != NULL)
+    {
+        if (length == 0)
+        {
+            return -1;
+        }
+
+        parts++;
+        text += length;
+    }
+
+    return parts;
+}
+
+size_t tweetJsonLength(const char *text, size_t length)
+{
+    size_t jsonBytes = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        jsonBytes += jsonLength(text[i]);
+    }
+
+    return jsonBytes;
+}
+
+size_t tweetJsonEscape(char *out, const char *text, size_t length)
+{
+    char *start = out;
+    for (size_t i = 0; i < length; i++)
+    {
+        char c = text[i];
+        switch (c)
+        {
+        case '"':
+        case '\\':
+            *out++ = '\\';
+            *out++ = c;
+            break;
+        case '\n':
+            *out++ = '\\';
+            *out++ = 'n';
+            break;
+        case '\r':
+            *out++ = '\\';
+            *out++ = 'r';
+            break;
+        case '\t':
+            *out++ = '\\';
+            *out++ = 't';
+            break;
+        case '\b':
+            *out++ = '\\';
+            *out++ = 'b';
+            break;
+        case '\f':
+            *out++ = '\\';
+            *out++ = 'f';
+            break;
+        default:
+            if ((uint8_t)c < 0x20)
+            {
+                out += sprintf(out, "\\u%04x", (uint8_t)c);
+            }
+            else
+            {
+                *out++ = c;
+            }
+        }
+    }
+    *out = '\0';
+
+    return out - start;
+}
@@ -0,0 +1,74 @@
+/*
+TweESP32 - A Twitter API library for the ESP32 that can tweet
+
+Copyright (c) 2022  Brian Lough.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+
+#ifndef TweetText_h
+#define TweetText_h
+
+#include <Arduino.h>
+
+// Twitter counts most characters as 1 and CJK characters and emoji as 2,
+// so a tweet can be 280 latin characters or 140 CJK characters
+#define TWEESP32_MAX_TWEET_WEIGHT 280
+
+// Links are shortened by t.co, so they count the same no matter how long they are
+#define TWEESP32_URL_WEIGHT 23
+
+// Most bytes of text sendTweet can fit in its request, counted once the
+// text is escaped for JSON (so a quote or a new line takes 2 bytes).
+// This fits 140 characters of up to 8 bytes, e.g. flags or emoji with a
+// skin tone. Longer emoji sequences (ZWJ families) can take up to ~35 bytes
+// for the same count, define this bigger if you need to send those.
+#ifndef TWEESP32_MAX_TWEET_BYTES
+#define TWEESP32_MAX_TWEET_BYTES 1120
+#endif
+
+// Works out the length Twitter will count for the text, without needing to
+// send it. Returns -1 if the text isn't valid UTF-8.
+//
+// This follows the twitter-text rules closely enough for a device: links
+// are only found if they start with http:// or https://, and emoji
+// sequences (skin tones, flags, ZWJ families) count as one emoji.
+int tweetWeightedLength(const char *text);
+
+// Returns how many bytes from the start of the text fit in a tweet, never
+// splitting a character, emoji or link. maxBytes is the room for the text
+// once it is escaped for JSON. With atWord it also avoids splitting words
+// (unless a single word is too long) and leaves off the trailing space.
+size_t tweetFitLength(const char *text, int maxWeight = TWEESP32_MAX_TWEET_WEIGHT, size_t maxBytes = TWEESP32_MAX_TWEET_BYTES, bool atWord = false);
+
+// Skips the spaces before the next part of the text, returning where it
+// starts (NULL at the end of the text) and its length. A length of 0 means
+// what's left can't fit in a tweet (e.g. a very long link).
+const char *nextTweetPart(const char *text, size_t &length, int maxWeight = TWEESP32_MAX_TWEET_WEIGHT, size_t maxBytes = TWEESP32_MAX_TWEET_BYTES);
+
+// Number of tweets needed to send the text split at words. Returns -1 if
+// the text isn't valid UTF-8 or has a link that can't fit in a tweet.
+int tweetPartCount(const char *text, int maxWeight = TWEESP32_MAX_TWEET_WEIGHT, size_t maxBytes = TWEESP32_MAX_TWEET_BYTES);
+
+// Number of bytes the first length bytes of text take once escaped for a JSON string
+size_t tweetJsonLength(const char *text, size_t length);
+
+// Writes the first length bytes of text escaped for a JSON string (without
+// the quotes) and null terminates it. out needs tweetJsonLength + 1 bytes.
+// Returns the number of bytes written, not counting the null.
+size_t tweetJsonEscape(char *out, const char *text, size_t length);
+
+#endif
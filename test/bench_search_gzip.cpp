@@ -0,0 +1,121 @@
+// searchTweets with and without gzip against a stand-in server: the bytes
+// that come over the wire, the time the reads spent waiting on the
+// connection (simulated, the host clock is moved on instead of sleeping)
+// and the time taken to inflate and parse.
+// Not run by ctest, run it on its own: ./bench_search_gzip
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <zlib.h>
+
+#include "ScriptedClient.h"
+#include "TweESP32.h"
+
+// For a rough idea of the transfer time, what a TLS connection on an ESP32
+// typically manages
+#define LINK_BYTES_PER_SECOND (100 * 1024)
+
+static const char *words[] = {
+    "sensor", "reading", "temperature", "the", "garden", "is", "at", "today", "humidity", "and",
+    "check", "out", "new", "build", "with", "an", "ESP32", "#IoT", "#maker", "@witnessmenow",
+    "https://t.co/Xk3p9QzL2a", "soldering", "display", "battery", "lasted", "weeks", "on", "one", "charge", "!"};
+
+static std::string searchBody(int tweets)
+{
+    uint32_t seed = 7;
+    auto next = [&seed]() {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) & 0x7fff;
+    };
+
+    std::string data = "{\"data\":[";
+    std::string users;
+    for (int i = 0; i < tweets; i++)
+    {
+        std::string authorId = std::to_string(1000000000UL + next() * 7919UL);
+        std::string text;
+        int length = 8 + next() % 30;
+        for (int w = 0; w < length; w++)
+        {
+            text += std::string(w == 0 ? "" : " ") + words[next() % (sizeof(words) / sizeof(words[0]))];
+        }
+        text += " " + std::to_string(next() % 1000) + "." + std::to_string(next() % 10);
+
+        data += std::string(i == 0 ? "" : ",") + "{\"author_id\":\"" + authorId + "\",\"id\":\"" +
+                std::to_string(1580000000000000000ULL - i * 9137ULL) + "\",\"text\":\"" + text + "\"}";
+        users += std::string(i == 0 ? "" : ",") + "{\"id\":\"" + authorId + "\",\"name\":\"Maker " +
+                 std::to_string(next()) + "\",\"username\":\"maker" + std::to_string(next()) + "\"}";
+    }
+    data += "],\"includes\":{\"users\":[" + users + "]},\"meta\":{\"newest_id\":\"1580000000000000000\","
+            "\"oldest_id\":\"1579999999999990863\",\"result_count\":" + std::to_string(tweets) + "}}";
+    return data;
+}
+
+static std::string gzip(const std::string &data)
+{
+    z_stream stream = {};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+
+    std::string out(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = (Bytef *)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef *)&out[0];
+    stream.avail_out = out.size();
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+static bool countResult(TweetSearchResult tweet, int index, int numResults)
+{
+    return true;
+}
+
+static void bench(int tweets, bool useGzip, int iterations)
+{
+    std::string body = searchBody(tweets);
+    ScriptedClient server(std::string("HTTP/1.1 200 OK\r\n"
+                                      "content-type: application/json; charset=utf-8\r\n") +
+                          (useGzip ? "content-encoding: gzip\r\n" : "") +
+                          "\r\n" + (useGzip ? gzip(body) : body));
+    TweESP32 twitter(server, "bearer");
+    twitter.useGzip = useGzip;
+    twitter.searchWithNameBufferSize = 64 * 1024;
+
+    TweESP32Context context;
+    char query[] = "%23maker";
+    unsigned long waited = 0;
+    int failed = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        unsigned long before = millis();
+        if (twitter.searchTweets(context, countResult, query) != tweets)
+        {
+            failed++;
+        }
+        waited += millis() - before;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double wireMs = server.response.size() * 1000.0 / LINK_BYTES_PER_SECOND;
+    double hostMs = seconds * 1000 / iterations;
+    double waitedMs = (double)waited / iterations;
+    printf("%6d %-8s %10zu %10.1f %10.1f %10.3f %10.1f%s\n", tweets, useGzip ? "gzip" : "identity",
+           server.response.size(), wireMs, waitedMs, hostMs, wireMs + waitedMs + hostMs, failed ? " (failed)" : "");
+}
+
+int main()
+{
+    printf("%6s %-8s %10s %10s %10s %10s %10s\n", "tweets", "encoding", "wire bytes", "wire ms", "waited ms", "host ms", "total ms");
+    int sizes[] = {10, 100};
+    for (int tweets : sizes)
+    {
+        bench(tweets, false, 200);
+        bench(tweets, true, 200);
+    }
+    return 0;
+}
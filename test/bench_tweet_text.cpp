@@ -0,0 +1,61 @@
+// Times the tweet text scanner on long multilingual text.
+// Not run by ctest, run it on its own: ./bench_tweet_text
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+
+#include "TweetText.h"
+
+static const char *samples[] = {
+    "Sensor 3 reports 21.5\xC2\xB0" "C and 45% humidity, all good. ",
+    "\xE6\xB8\xA9\xE5\xBA\xA6\xE3\x81\xAF" "21.5\xE5\xBA\xA6\xE3\x81\xA7\xE3\x81\x99\xE3\x80\x82 ",   // Japanese
+    "\xD0\xA2\xD0\xB5\xD0\xBC\xD0\xBF\xD0\xB5\xD1\x80\xD0\xB0\xD1\x82\xD1\x83\xD1\x80\xD0\xB0 21.5 ", // Russian
+    "\xD8\xAF\xD8\xB1\xD8\xAC\xD8\xA9 \xD8\xA7\xD9\x84\xD8\xAD\xD8\xB1\xD8\xA7\xD8\xB1\xD8\xA9 ",   // Arabic
+    "\xF0\x9F\x8C\xA1\xEF\xB8\x8F \xF0\x9F\x91\x8D\xF0\x9F\x8F\xBD \xF0\x9F\x87\xAC\xF0\x9F\x87\xA7 ", // emoji
+    "https://example.com/sensors/3?range=24h\n",
+};
+
+template <typename Function>
+static void bench(const char *name, const std::string &text, int iterations, Function function)
+{
+    volatile long sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        sink += function(text.c_str());
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double bytes = (double)text.size() * iterations;
+    printf("%-22s %8.1f MB/s %8.2f ns/byte\n", name, bytes / seconds / 1e6, seconds * 1e9 / bytes);
+}
+
+int main()
+{
+    std::string text;
+    while (text.size() < 64 * 1024)
+    {
+        for (const char *sample : samples)
+        {
+            text += sample;
+        }
+    }
+
+    printf("%zu bytes of text, weighted length %d, %d tweets\n", text.size(), tweetWeightedLength(text.c_str()), tweetPartCount(text.c_str()));
+
+    bench("tweetWeightedLength", text, 200, [](const char *t)
+          { return (long)tweetWeightedLength(t); });
+    bench("tweetPartCount", text, 200, [](const char *t)
+          { return (long)tweetPartCount(t); });
+    bench("tweetJsonLength", text, 200, [](const char *t)
+          { return (long)tweetJsonLength(t, strlen(t)); });
+
+    // A single tweet's worth, the usual case on a device
+    std::string tweet = text.substr(0, tweetFitLength(text.c_str()));
+    bench("tweetFitLength (tweet)", tweet, 200000, [](const char *t)
+          { return (long)tweetFitLength(t); });
+
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include "Arduino.h"
+#include "UrlEncode.h"
+#include "freertos/semphr.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+
+HardwareSerial Serial;
+
+// Serial output goes to stderr, and only when TWEESP32_TEST_SERIAL is set
+size_t HardwareSerial::write(uint8_t c)
+{
+    static bool enabled = getenv("TWEESP32_TEST_SERIAL") != NULL;
+    if (enabled)
+    {
+        fputc(c, stderr);
+    }
+    return 1;
+}
+
+static unsigned long hostMillis = 0;
+static time_t hostEpoch = 0;
+static std::mutex clockLock;
+
+unsigned long millis()
+{
+    std::lock_guard<std::mutex> lock(clockLock);
+    return hostMillis;
+}
+
+void hostSetMillis(unsigned long ms)
+{
+    std::lock_guard<std::mutex> lock(clockLock);
+    hostMillis = ms;
+}
+
+void hostAdvanceMillis(unsigned long ms)
+{
+    std::lock_guard<std::mutex> lock(clockLock);
+    hostMillis += ms;
+    if (hostEpoch != 0)
+    {
+        hostEpoch = hostEpoch + (time_t)(hostMillis / 1000 - (hostMillis - ms) / 1000);
+    }
+}
+
+void hostSetEpoch(time_t epoch)
+{
+    std::lock_guard<std::mutex> lock(clockLock);
+    hostEpoch = epoch;
+}
+
+void delay(unsigned long ms)
+{
+    hostAdvanceMillis(ms);
+}
+
+void yield()
+{
+}
+
+long random(long max)
+{
+    thread_local std::mt19937 generator(std::random_device{}());
+    return max <= 0 ? 0 : (long)(generator() % (unsigned long)max);
+}
+
+long random(long min, long max)
+{
+    return min + random(max - min);
+}
+
+// Replaces the C library's, so the library reads the same simulated clock as
+// getLocalTime. On the ESP32 both are the system clock that SNTP sets
+extern "C" time_t time(time_t *out) noexcept
+{
+    std::lock_guard<std::mutex> lock(clockLock);
+    if (out != NULL)
+    {
+        *out = hostEpoch;
+    }
+    return hostEpoch;
+}
+
+// Like the ESP32, fails while the clock is still at its default, after
+// waiting up to ms for it to be set
+bool getLocalTime(struct tm *info, uint32_t ms)
+{
+    std::unique_lock<std::mutex> lock(clockLock);
+    if (hostEpoch == 0)
+    {
+        lock.unlock();
+        hostAdvanceMillis(ms);
+        return false;
+    }
+    gmtime_r(&hostEpoch, info);
+    return true;
+}
+
+void configTime(long gmtOffset, int daylightOffset, const char *server1, const char *server2, const char *server3)
+{
+}
+
+String urlEncode(const char *str)
+{
+    static const char *hex = "0123456789ABCDEF";
+    String encoded;
+    for (const char *c = str; *c != '\0'; c++)
+    {
+        if (isalnum((unsigned char)*c) || *c == '-' || *c == '_' || *c == '.' || *c == '~')
+        {
+            encoded += *c;
+        }
+        else
+        {
+            encoded += '%';
+            encoded += hex[(uint8_t)*c >> 4];
+            encoded += hex[(uint8_t)*c & 0x0F];
+        }
+    }
+    return encoded;
+}
+
+String urlEncode(String str)
+{
+    return urlEncode(str.c_str());
+}
+
+struct HostSemaphore
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    UBaseType_t count;
+    UBaseType_t maxCount;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount)
+{
+    // FreeRTOS asserts on this
+    if (maxCount == 0 || initialCount > maxCount)
+    {
+        abort();
+    }
+
+    HostSemaphore *semaphore = new HostSemaphore();
+    semaphore->count = initialCount;
+    semaphore->maxCount = maxCount;
+    return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait)
+{
+    std::unique_lock<std::mutex> lock(semaphore->lock);
+    auto hasCount = [semaphore]()
+    { return semaphore->count > 0; };
+    if (ticksToWait == portMAX_DELAY)
+    {
+        semaphore->changed.wait(lock, hasCount);
+    }
+    else if (!semaphore->changed.wait_for(lock, std::chrono::milliseconds(ticksToWait), hasCount))
+    {
+        return pdFALSE;
+    }
+
+    semaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    std::lock_guard<std::mutex> lock(semaphore->lock);
+    if (semaphore->count == semaphore->maxCount)
+    {
+        return pdFALSE;
+    }
+    semaphore->count++;
+    semaphore->changed.notify_one();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    delete semaphore;
+}
+
+UBaseType_t uxSemaphoreGetCount(SemaphoreHandle_t semaphore)
+{
+    std::lock_guard<std::mutex> lock(semaphore->lock);
+    return semaphore->count;
+}
@@ -0,0 +1,223 @@
+// Just enough of the Arduino core for the library to run on a PC, so the
+// parts that don't need the network or the ESP32 can be tested.
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <string>
+
+typedef uint8_t byte;
+
+#define F(string_literal) (string_literal)
+
+unsigned long millis();
+void delay(unsigned long ms);
+void yield();
+long random(long max);
+long random(long min, long max);
+bool getLocalTime(struct tm *info, uint32_t ms = 5000);
+void configTime(long gmtOffset, int daylightOffset, const char *server1, const char *server2 = NULL, const char *server3 = NULL);
+
+inline bool isAlphaNumeric(int c) { return isalnum(c) != 0; }
+
+// Tests move the clocks instead of waiting
+void hostSetMillis(unsigned long ms);
+void hostAdvanceMillis(unsigned long ms);
+void hostSetEpoch(time_t epoch); // 0 for a clock that hasn't been set
+
+class String
+{
+public:
+  String() {}
+  String(const char *value) : _value(value != NULL ? value : "") {}
+  String(int value) : _value(std::to_string(value)) {}
+  String(unsigned int value) : _value(std::to_string(value)) {}
+  String(long value) : _value(std::to_string(value)) {}
+  String(unsigned long value) : _value(std::to_string(value)) {}
+
+  String &operator+=(const String &other) { _value += other._value; return *this; }
+  String &operator+=(const char *other) { _value += other; return *this; }
+  String &operator+=(char other) { _value += other; return *this; }
+  String operator+(const String &other) const { String result(*this); result += other; return result; }
+  String operator+(const char *other) const { String result(*this); result += other; return result; }
+  bool operator==(const char *other) const { return _value == other; }
+
+  const char *c_str() const { return _value.c_str(); }
+  unsigned int length() const { return _value.size(); }
+  char operator[](unsigned int index) const { return _value[index]; }
+
+private:
+  std::string _value;
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    size_t written = 0;
+    while (size-- > 0 && write(*buffer++) == 1)
+    {
+      written++;
+    }
+    return written;
+  }
+  size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual void flush() {}
+
+  size_t print(const char *str) { return write(str); }
+  size_t print(const String &str) { return write(str.c_str()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int value) { return printNumber(std::to_string(value)); }
+  size_t print(unsigned int value) { return printNumber(std::to_string(value)); }
+  size_t print(long value) { return printNumber(std::to_string(value)); }
+  size_t print(unsigned long value) { return printNumber(std::to_string(value)); }
+  size_t print(double value) { return printNumber(std::to_string(value)); }
+
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(T value)
+  {
+    size_t written = print(value);
+    return written + println();
+  }
+
+private:
+  size_t printNumber(const std::string &number) { return write(number.c_str()); }
+};
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeout) { _timeout = timeout; }
+  unsigned long getTimeout() { return _timeout; }
+
+  bool find(const char *target)
+  {
+    size_t length = strlen(target);
+    size_t matched = 0;
+    int c;
+    while ((c = timedRead()) >= 0)
+    {
+      if (c == target[matched])
+      {
+        if (++matched == length)
+        {
+          return true;
+        }
+      }
+      else
+      {
+        matched = (c == target[0]) ? 1 : 0;
+      }
+    }
+    return false;
+  }
+
+  long parseInt()
+  {
+    int c;
+    while ((c = timedPeek()) >= 0 && c != '-' && !isdigit(c))
+    {
+      read();
+    }
+
+    bool negative = false;
+    long value = 0;
+    if (c == '-')
+    {
+      negative = true;
+      read();
+    }
+    while ((c = timedPeek()) >= 0 && isdigit(c))
+    {
+      value = value * 10 + (c - '0');
+      read();
+    }
+    return negative ? -value : value;
+  }
+
+  virtual size_t readBytes(char *buffer, size_t length)
+  {
+    size_t count = 0;
+    while (count < length)
+    {
+      int c = timedRead();
+      if (c < 0)
+      {
+        break;
+      }
+      buffer[count++] = (char)c;
+    }
+    return count;
+  }
+  size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+
+  size_t readBytesUntil(char terminator, char *buffer, size_t length)
+  {
+    size_t count = 0;
+    while (count < length)
+    {
+      int c = timedRead();
+      if (c < 0 || c == terminator)
+      {
+        break;
+      }
+      buffer[count++] = (char)c;
+    }
+    return count;
+  }
+
+protected:
+  unsigned long _timeout = 1000;
+
+  // Nothing arrives later on the host, so a timed read that finds nothing
+  // is one the ESP32 would have waited the whole timeout on. Move the clock
+  // on by as much, so tests can see those waits
+  int timedRead()
+  {
+    int c = read();
+    if (c < 0)
+    {
+      hostAdvanceMillis(_timeout);
+    }
+    return c;
+  }
+  int timedPeek()
+  {
+    int c = peek();
+    if (c < 0)
+    {
+      hostAdvanceMillis(_timeout);
+    }
+    return c;
+  }
+};
+
+class HardwareSerial : public Stream
+{
+public:
+  size_t write(uint8_t c);
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+};
+
+extern HardwareSerial Serial;
+
+#endif
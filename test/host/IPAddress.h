@@ -0,0 +1,16 @@
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <stdint.h>
+
+class IPAddress
+{
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+
+private:
+  uint32_t _address = 0;
+};
+
+#endif
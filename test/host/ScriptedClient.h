@@ -0,0 +1,98 @@
+#ifndef ScriptedClient_h
+#define ScriptedClient_h
+
+#include <string>
+
+#include "Client.h"
+
+// Stands in for a server: every connection plays back the same response,
+// and what was written since connecting is kept so tests can check the
+// request. Override received() to answer based on the request instead.
+class ScriptedClient : public Client
+{
+public:
+  ScriptedClient(const std::string &response = "") : response(response) {}
+
+  // Played back on every connection
+  std::string response;
+
+  // How many connects fail before they start working
+  int failConnects = 0;
+
+  int attempts = 0;    // Calls to connect
+  int connections = 0; // Connects that worked
+  std::string host;    // Of the last connect that worked
+  std::string request; // Everything written since then
+
+  int connect(IPAddress ip, uint16_t port) { return connect("", port); }
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) { return connect("", port); }
+  int connect(const char *host, uint16_t port, int32_t timeout) { return connect(host, port); }
+  int connect(const char *host, uint16_t port)
+  {
+    attempts++;
+    if (attempts <= failConnects)
+    {
+      return 0;
+    }
+
+    connections++;
+    this->host = host;
+    request.clear();
+    reply(response);
+    _connected = true;
+    return 1;
+  }
+
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size)
+  {
+    if (!_connected)
+    {
+      return 0;
+    }
+    request.append((const char *)buffer, size);
+    received();
+    return size;
+  }
+
+  int available() { return _reply.size() - _position; }
+  int read() { return _position < _reply.size() ? (uint8_t)_reply[_position++] : -1; }
+  int peek() { return _position < _reply.size() ? (uint8_t)_reply[_position] : -1; }
+
+  // Like WiFiClient, only returns what has already arrived
+  int read(uint8_t *buffer, size_t size)
+  {
+    size_t length = _reply.size() - _position < size ? _reply.size() - _position : size;
+    if (length == 0)
+    {
+      return -1;
+    }
+    memcpy(buffer, _reply.data() + _position, length);
+    _position += length;
+    return length;
+  }
+
+  void flush() {}
+  void stop() { _connected = false; }
+  uint8_t connected() { return _connected || available() > 0; }
+  operator bool() { return _connected; }
+
+protected:
+  bool _connected = false;
+
+  // Called after every write, request holds everything sent so far
+  virtual void received() {}
+
+  // Replaces what is left to be read
+  void reply(const std::string &data)
+  {
+    _reply = data;
+    _position = 0;
+  }
+
+private:
+  std::string _reply;
+  size_t _position = 0;
+};
+
+#endif
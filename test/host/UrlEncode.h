@@ -0,0 +1,9 @@
+#ifndef UrlEncode_h
+#define UrlEncode_h
+
+#include "Arduino.h"
+
+String urlEncode(const char *str);
+String urlEncode(String str);
+
+#endif
@@ -0,0 +1,64 @@
+#include "rom/miniz.h"
+
+static voidpf arenaAlloc(voidpf opaque, uInt items, uInt size)
+{
+    tinfl_decompressor *r = (tinfl_decompressor *)opaque;
+    size_t bytes = ((size_t)items * size + 15) & ~(size_t)15;
+    if (r->arenaUsed + bytes > sizeof(r->arena))
+    {
+        return Z_NULL;
+    }
+    voidpf block = r->arena + r->arenaUsed;
+    r->arenaUsed += bytes;
+    return block;
+}
+
+static void arenaFree(voidpf opaque, voidpf address)
+{
+}
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mz_uint32 decomp_flags)
+{
+    if (r->m_state == 0)
+    {
+        r->stream = z_stream();
+        r->stream.zalloc = arenaAlloc;
+        r->stream.zfree = arenaFree;
+        r->stream.opaque = r;
+        if (inflateInit2(&r->stream, -MAX_WBITS) != Z_OK)
+        {
+            return TINFL_STATUS_FAILED;
+        }
+        r->m_state = 1;
+    }
+
+    // The window wraps, so tinfl is never asked to write past its end
+    if (pOut_buf_next + *pOut_buf_size > pOut_buf_start + TINFL_LZ_DICT_SIZE)
+    {
+        return TINFL_STATUS_BAD_PARAM;
+    }
+
+    r->stream.next_in = (Bytef *)pIn_buf_next;
+    r->stream.avail_in = *pIn_buf_size;
+    r->stream.next_out = pOut_buf_next;
+    r->stream.avail_out = *pOut_buf_size;
+
+    int result = inflate(&r->stream, Z_NO_FLUSH);
+
+    *pIn_buf_size -= r->stream.avail_in;
+    *pOut_buf_size -= r->stream.avail_out;
+
+    if (result == Z_STREAM_END)
+    {
+        return TINFL_STATUS_DONE;
+    }
+    if (result != Z_OK && result != Z_BUF_ERROR)
+    {
+        return TINFL_STATUS_FAILED;
+    }
+    if (r->stream.avail_out == 0)
+    {
+        return TINFL_STATUS_HAS_MORE_OUTPUT;
+    }
+    return (decomp_flags & TINFL_FLAG_HAS_MORE_INPUT) ? TINFL_STATUS_NEEDS_MORE_INPUT : TINFL_STATUS_FAILED;
+}
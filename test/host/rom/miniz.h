@@ -0,0 +1,53 @@
+#ifndef miniz_h
+#define miniz_h
+
+// The tinfl API from the ESP32 ROM, implemented on zlib's raw inflate.
+// Only what GzipStream uses.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+typedef uint8_t mz_uint8;
+typedef uint32_t mz_uint32;
+
+enum
+{
+  TINFL_FLAG_PARSE_ZLIB_HEADER = 1,
+  TINFL_FLAG_HAS_MORE_INPUT = 2,
+  TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF = 4,
+  TINFL_FLAG_COMPUTE_ADLER32 = 8
+};
+
+typedef enum
+{
+  TINFL_STATUS_BAD_PARAM = -3,
+  TINFL_STATUS_ADLER32_MISMATCH = -2,
+  TINFL_STATUS_FAILED = -1,
+  TINFL_STATUS_DONE = 0,
+  TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+  TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+#define TINFL_LZ_DICT_SIZE 32768
+
+// zlib allocates from the arena, so freeing the decompressor frees
+// everything, the same as the ROM version
+typedef struct
+{
+  mz_uint32 m_state;
+  z_stream stream;
+  size_t arenaUsed;
+  unsigned char arena[64 * 1024];
+} tinfl_decompressor;
+
+#define tinfl_init(r)    \
+  do                     \
+  {                      \
+    (r)->m_state = 0;    \
+    (r)->arenaUsed = 0;  \
+  } while (0)
+
+tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mz_uint32 decomp_flags);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef test_h
+#define test_h
+
+// A few checks that print where they failed and keep going, so one run
+// shows every failure. main() returns TEST_RESULT().
+
+#include <stdio.h>
+#include <string.h>
+
+static int testFailures = 0;
+
+#define CHECK(condition)                                                  \
+  do                                                                      \
+  {                                                                       \
+    if (!(condition))                                                     \
+    {                                                                     \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+      testFailures++;                                                     \
+    }                                                                     \
+  } while (0)
+
+#define CHECK_EQUAL(expected, actual)                                                                   \
+  do                                                                                                    \
+  {                                                                                                     \
+    long long expectedValue = (long long)(expected);                                                    \
+    long long actualValue = (long long)(actual);                                                        \
+    if (expectedValue != actualValue)                                                                   \
+    {                                                                                                   \
+      printf("%s:%d: expected %s == %lld, got %lld\n", __FILE__, __LINE__, #actual, expectedValue, actualValue); \
+      testFailures++;                                                                                   \
+    }                                                                                                   \
+  } while (0)
+
+#define CHECK_STRING(expected, actual)                                                               \
+  do                                                                                                 \
+  {                                                                                                  \
+    const char *expectedValue = (expected);                                                          \
+    const char *actualValue = (actual);                                                              \
+    if (actualValue == NULL || strcmp(expectedValue, actualValue) != 0)                              \
+    {                                                                                                \
+      printf("%s:%d: expected %s == \"%s\", got \"%s\"\n", __FILE__, __LINE__, #actual, expectedValue, \
+             actualValue == NULL ? "(null)" : actualValue);                                          \
+      testFailures++;                                                                                \
+    }                                                                                                \
+  } while (0)
+
+#define TEST_RESULT() (testFailures == 0 ? 0 : 1)
+
+#endif
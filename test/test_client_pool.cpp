@@ -0,0 +1,285 @@
+#include "test.h"
+
+// Several tasks searching through one TweESP32 with a client pool, meant to
+// be run with -DTWEESP32_SANITIZE=thread so any shared state that isn't
+// protected shows up as a race. Also times the same searches with each size
+// of pool, against a server that takes a while to answer.
+
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ScriptedClient.h"
+#include "TweESP32.h"
+
+#define TASKS 6
+#define CLIENTS 3
+#define SEARCHES_PER_TASK 200
+
+// Real time each request spends on the "network" in the throughput run,
+// much longer than the library's own work so that is what gets measured
+#define LATENCY_MS 20
+#define TIMED_SEARCHES_PER_TASK 10
+
+static const char *searchResponse =
+    "HTTP/1.1 200 OK\r\n"
+    "content-type: application/json; charset=utf-8\r\n"
+    "x-rate-limit-remaining: 449\r\n"
+    "x-rate-limit-reset: 1666000000\r\n"
+    "\r\n"
+    "{\"data\":[{\"author_id\":\"2244994945\",\"id\":\"1580000000000000001\",\"text\":\"first\"},"
+    "{\"author_id\":\"2244994945\",\"id\":\"1580000000000000000\",\"text\":\"second\"}],"
+    "\"includes\":{\"users\":[{\"id\":\"2244994945\",\"name\":\"Twitter Dev\",\"username\":\"TwitterDev\"}]},"
+    "\"meta\":{\"newest_id\":\"1580000000000000001\",\"oldest_id\":\"1580000000000000000\",\"result_count\":2}}";
+
+// Answers every request with the same search response, and notices if two
+// tasks ever use it at once
+class FakeClient : public ScriptedClient
+{
+public:
+    std::atomic<int> users{0};
+    std::atomic<bool> shared{false};
+
+    // While set, connecting waits, so a request can be held in the middle
+    std::atomic<bool> hold{false};
+    std::atomic<bool> connecting{false};
+
+    // Real time taken to connect and get the response, in ms
+    int latency = 0;
+
+    FakeClient() : ScriptedClient(searchResponse) {}
+
+    int connect(const char *host, uint16_t port)
+    {
+        if (users.fetch_add(1) != 0)
+        {
+            shared = true;
+        }
+        connecting = true;
+        while (hold)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+        return ScriptedClient::connect(host, port);
+    }
+
+    void stop()
+    {
+        if (_connected)
+        {
+            users--;
+        }
+        ScriptedClient::stop();
+    }
+};
+
+// Every other connection to a host "resumes", and it is called from every task
+class FakeSessionCache : public TlsSessionCache
+{
+public:
+    bool apply(Client &client, const char *host) { return true; }
+
+    bool save(Client &client, const char *host)
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        return _saves++ % 2 == 1;
+    }
+
+    void clear(const char *host) {}
+
+private:
+    std::mutex _lock;
+    int _saves = 0;
+};
+
+static bool countResult(TweetSearchResult tweet, int index, int numResults)
+{
+    return tweet.text != NULL && tweet.username != NULL && strcmp(tweet.username, "TwitterDev") == 0;
+}
+
+static void testTasksShareThePool()
+{
+    FakeClient unpooled;
+    FakeClient clients[CLIENTS];
+    Client *pool[CLIENTS];
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        pool[i] = &clients[i];
+    }
+
+    FakeSessionCache sessionCache;
+    TweESP32 twitter(unpooled, "bearer");
+    CHECK(twitter.setClientPool(pool, CLIENTS));
+    twitter.setTlsSessionCache(&sessionCache);
+
+    std::atomic<int> found{0};
+    std::atomic<int> failed{0};
+    std::vector<std::thread> tasks;
+    for (int t = 0; t < TASKS; t++)
+    {
+        tasks.emplace_back([&]() {
+            TweESP32Context context;
+            char query[] = "from%3Atwitterdev";
+            for (int i = 0; i < SEARCHES_PER_TASK; i++)
+            {
+                int results = twitter.searchTweets(context, countResult, query);
+                if (results == 2 && strcmp(context.tweetId, "1580000000000000001") == 0 &&
+                    context.rateLimitRemaining == 449 && context.rateLimitReset == 1666000000)
+                {
+                    found += results;
+                }
+                else
+                {
+                    failed++;
+                }
+            }
+        });
+    }
+    for (std::thread &task : tasks)
+    {
+        task.join();
+    }
+
+    CHECK_EQUAL(0, failed.load());
+    CHECK_EQUAL(TASKS * SEARCHES_PER_TASK * 2, found.load());
+
+    // Every request used one of the pool, never the same one at once
+    int connections = 0;
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        CHECK(!clients[i].shared);
+        CHECK(clients[i].connections > 0);
+        connections += clients[i].connections;
+    }
+    CHECK_EQUAL(0, unpooled.connections);
+    CHECK_EQUAL(TASKS * SEARCHES_PER_TASK, connections);
+
+    // No increments lost
+    CHECK_EQUAL(TASKS * SEARCHES_PER_TASK / 2, twitter.fullHandshakes.load());
+    CHECK_EQUAL(TASKS * SEARCHES_PER_TASK / 2, twitter.resumedHandshakes.load());
+}
+
+static void testSettingThePool()
+{
+    FakeClient unpooled;
+    FakeClient clients[2];
+    Client *pool[] = {&clients[0], &clients[1]};
+    TweESP32 twitter(unpooled, "bearer");
+
+    // Nothing to wait on
+    CHECK(!twitter.setClientPool(pool, 0));
+    CHECK(!twitter.setClientPool(pool, -1));
+    CHECK(!twitter.setClientPool(NULL, 2));
+
+    // The raw request methods keep the constructor's client to themselves
+    Client *withUnpooled[] = {&clients[0], &unpooled};
+    CHECK(!twitter.setClientPool(withUnpooled, 2));
+    Client *withNull[] = {&clients[0], NULL};
+    CHECK(!twitter.setClientPool(withNull, 2));
+
+    CHECK(twitter.setClientPool(pool, 2));
+    CHECK_EQUAL(200, twitter.makeGetRequest("/2/tweets/search/recent?query=dogs", "Bearer bearer"));
+    CHECK_EQUAL(1, unpooled.connections);
+    CHECK_EQUAL(0, clients[0].connections + clients[1].connections);
+    unpooled.stop();
+
+    // Can't be swapped out from under a request
+    clients[0].hold = true;
+    std::thread task([&]() {
+        TweESP32Context context;
+        char query[] = "from%3Atwitterdev";
+        twitter.searchTweets(context, countResult, query);
+    });
+    while (!clients[0].connecting)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    Client *otherPool[] = {&clients[1]};
+    CHECK(!twitter.setClientPool(otherPool, 1));
+    clients[0].hold = false;
+    task.join();
+
+    CHECK(twitter.setClientPool(otherPool, 1));
+}
+
+// Searches per second with TWEESP32_MAX_CLIENTS tasks sharing a pool of
+// numClients, each request taking LATENCY_MS
+static double timeSearches(int numClients)
+{
+    FakeClient unpooled;
+    FakeClient clients[TWEESP32_MAX_CLIENTS];
+    Client *pool[TWEESP32_MAX_CLIENTS];
+    for (int i = 0; i < numClients; i++)
+    {
+        clients[i].latency = LATENCY_MS;
+        pool[i] = &clients[i];
+    }
+
+    TweESP32 twitter(unpooled, "bearer");
+    CHECK(twitter.setClientPool(pool, numClients));
+
+    std::atomic<int> failed{0};
+    std::vector<std::thread> tasks;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < TWEESP32_MAX_CLIENTS; t++)
+    {
+        tasks.emplace_back([&]() {
+            TweESP32Context context;
+            char query[] = "from%3Atwitterdev";
+            for (int i = 0; i < TIMED_SEARCHES_PER_TASK; i++)
+            {
+                if (twitter.searchTweets(context, countResult, query) != 2)
+                {
+                    failed++;
+                }
+            }
+        });
+    }
+    for (std::thread &task : tasks)
+    {
+        task.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    CHECK_EQUAL(0, failed.load());
+    CHECK_EQUAL(0, unpooled.connections);
+    return TWEESP32_MAX_CLIENTS * TIMED_SEARCHES_PER_TASK / seconds;
+}
+
+static void testThroughputGrowsWithThePool()
+{
+    // One request at a time can't do better than this
+    double oneAtATime = 1000.0 / LATENCY_MS;
+
+    printf("%7s %12s %10s\n", "clients", "searches/s", "speedup");
+    double throughput[TWEESP32_MAX_CLIENTS + 1];
+    for (int numClients = 1; numClients <= TWEESP32_MAX_CLIENTS; numClients++)
+    {
+        throughput[numClients] = timeSearches(numClients);
+        printf("%7d %12.1f %9.2fx\n", numClients, throughput[numClients], throughput[numClients] / oneAtATime);
+    }
+
+    // Loose bounds, as the threads are at the mercy of the scheduler (and
+    // the sanitizers slow things down), but a pool that serialised requests
+    // wouldn't get near them
+    CHECK(throughput[1] <= oneAtATime * 1.1);
+    for (int numClients = 2; numClients <= TWEESP32_MAX_CLIENTS; numClients++)
+    {
+        CHECK(throughput[numClients] > throughput[1] * numClients * 0.6);
+    }
+}
+
+int main()
+{
+    hostSetEpoch(1666000000);
+    testTasksShareThePool();
+    testSettingThePool();
+    testThroughputGrowsWithThePool();
+    return TEST_RESULT();
+}
@@ -0,0 +1,130 @@
+#include "test.h"
+
+// context.timeout covers the whole call, so no step should be given more
+// time than is left of it.
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "ScriptedClient.h"
+#include "TweESP32.h"
+
+static const char *emptySearch =
+    "HTTP/1.1 200 OK\r\n"
+    "content-type: application/json; charset=utf-8\r\n"
+    "\r\n"
+    "{\"meta\":{\"result_count\":0}}";
+
+// Takes its time finding the session, using up the budget before connecting
+class SlowSessionCache : public TlsSessionCache
+{
+public:
+    unsigned long takes = 0;
+
+    bool apply(Client &client, const char *host)
+    {
+        hostAdvanceMillis(takes);
+        return false;
+    }
+    bool save(Client &client, const char *host) { return false; }
+    void clear(const char *host) {}
+};
+
+// Connecting waits while hold is set, so a request can keep it busy
+class HeldClient : public ScriptedClient
+{
+public:
+    std::atomic<bool> hold{false};
+    std::atomic<bool> connecting{false};
+
+    HeldClient() : ScriptedClient(emptySearch) {}
+
+    int connect(const char *host, uint16_t port)
+    {
+        connecting = true;
+        while (hold)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return ScriptedClient::connect(host, port);
+    }
+};
+
+static void testSpentBudgetDoesntConnect()
+{
+    hostSetEpoch(1666000000);
+    ScriptedClient client(emptySearch);
+    SlowSessionCache cache;
+    TweESP32 twitter(client, "bearer");
+    twitter.setTlsSessionCache(&cache);
+
+    TweESP32Context context;
+    context.timeout = 500;
+    char query[] = "%23dogs";
+
+    cache.takes = 100;
+    CHECK_EQUAL(0, twitter.searchTweets(context, NULL, query));
+    CHECK_EQUAL(1, client.attempts);
+    CHECK(context.timeRemaining > 0);
+
+    // A connect timeout of 0 would be the client's default, so it isn't tried
+    cache.takes = 500;
+    CHECK_EQUAL(-1, twitter.searchTweets(context, NULL, query));
+    CHECK_EQUAL(1, client.attempts);
+    CHECK_EQUAL(TWEESP32_DEADLINE_EXCEEDED, context.error.httpStatus);
+    CHECK_EQUAL(0, context.timeRemaining);
+}
+
+static void testPoolWaitsForWhatsLeft()
+{
+    // Clock not set yet, so signing waits for it (5s on the host clock)
+    // before asking for a connection
+    hostSetEpoch(0);
+    ScriptedClient unpooled;
+    HeldClient pooled;
+    Client *pool[] = {&pooled};
+    TweESP32 twitter(unpooled, "consumerKey", "consumerSecret", "accessToken", "accessTokenSecret", "bearer");
+    CHECK(twitter.setClientPool(pool, 1));
+
+    pooled.hold = true;
+    std::thread busy([&]() {
+        TweESP32Context context;
+        char query[] = "%23dogs";
+        twitter.searchTweets(context, NULL, query);
+    });
+    while (!pooled.connecting)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Only 200ms of the budget is left to wait for the busy connection
+    TweESP32Context context;
+    context.timeout = 5200;
+    char message[] = "Hello";
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!twitter.sendTweet(context, message));
+    long waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(waited >= 150);
+    CHECK(waited < 2000);
+    CHECK_EQUAL(TWEESP32_DEADLINE_EXCEEDED, context.error.httpStatus);
+
+    // Nothing left at all, so no waiting
+    context.timeout = 5000;
+    start = std::chrono::steady_clock::now();
+    CHECK(!twitter.sendTweet(context, message));
+    waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(waited < 100);
+    CHECK_EQUAL(TWEESP32_DEADLINE_EXCEEDED, context.error.httpStatus);
+
+    pooled.hold = false;
+    busy.join();
+    CHECK_EQUAL(1, pooled.connections);
+}
+
+int main()
+{
+    testSpentBudgetDoesntConnect();
+    testPoolWaitsForWhatsLeft();
+    return TEST_RESULT();
+}
@@ -0,0 +1,258 @@
+#include "test.h"
+
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "GzipStream.h"
+
+// Serves a fixed buffer, like a response body that has fully arrived
+class BufferStream : public Stream
+{
+public:
+    BufferStream(const std::string &data) : _data(data) {}
+
+    int available() { return _data.size() - _position; }
+    int read() { return _position < _data.size() ? (uint8_t)_data[_position++] : -1; }
+    int peek() { return _position < _data.size() ? (uint8_t)_data[_position] : -1; }
+    size_t write(uint8_t c) { return 0; }
+
+    size_t position() { return _position; }
+
+private:
+    std::string _data;
+    size_t _position = 0;
+};
+
+static std::string rawDeflate(const std::string &data)
+{
+    z_stream stream = {};
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY);
+
+    std::string out(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = (Bytef *)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef *)&out[0];
+    stream.avail_out = out.size();
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+static void appendLittleEndian(std::string &out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        out += (char)((value >> (i * 8)) & 0xff);
+    }
+}
+
+// A gzip member with the optional header fields given by flags
+static std::string gzip(const std::string &data, uint8_t flags = 0)
+{
+    std::string out = {'\x1f', '\x8b', 8, (char)flags, 0, 0, 0, 0, 0, 3};
+    if (flags & 0x04)
+    {
+        out += std::string("\x06\x00" "abcdef", 8);
+    }
+    if (flags & 0x08)
+    {
+        out += std::string("search.json\0", 12);
+    }
+    if (flags & 0x10)
+    {
+        out += std::string("a comment\0", 10);
+    }
+    if (flags & 0x02)
+    {
+        out += std::string("\x12\x34", 2);
+    }
+
+    out += rawDeflate(data);
+    appendLittleEndian(out, crc32(0, (const Bytef *)data.data(), data.size()));
+    appendLittleEndian(out, data.size());
+    return out;
+}
+
+// JSON-ish text that repeats from far back, so matches reach across the window
+static std::string searchResponse(size_t size)
+{
+    std::string data;
+    uint32_t seed = 1;
+    while (data.size() < size)
+    {
+        seed = seed * 1103515245 + 12345;
+        data += "{\"id\":\"" + std::to_string(seed % 100000) + "\",\"text\":\"Tweet number ";
+        data += std::to_string(seed % 977) + "\"},";
+        // Some bytes that won't compress, so stored blocks are covered too
+        if (seed % 13 == 0)
+        {
+            for (int i = 0; i < 300; i++)
+            {
+                seed = seed * 1103515245 + 12345;
+                data += (char)(seed >> 16);
+            }
+        }
+    }
+    data.resize(size);
+    return data;
+}
+
+static std::string readAll(GzipStream &stream)
+{
+    std::string out;
+    int c;
+    while ((c = stream.read()) >= 0)
+    {
+        out += (char)c;
+    }
+    return out;
+}
+
+static void testSmallBody()
+{
+    std::string json = "{\"title\":\"Too Many Requests\",\"detail\":\"Too Many Requests\"}";
+    BufferStream source(gzip(json));
+    GzipStream stream(source);
+    CHECK(stream.begin());
+    CHECK(stream.available() > 0);
+    CHECK_EQUAL('{', stream.peek());
+    CHECK_EQUAL('{', stream.peek());
+    CHECK(readAll(stream) == json);
+    CHECK_EQUAL(-1, stream.read());
+    CHECK_EQUAL(-1, stream.peek());
+    CHECK_EQUAL(0, stream.available());
+    CHECK_EQUAL(json.size(), stream.decompressedBytes());
+    CHECK_EQUAL(source.position(), stream.compressedBytesRead());
+}
+
+static void testLargerThanWindow()
+{
+    std::string data = searchResponse(5 * TWEESP32_GZIP_WINDOW_SIZE + 123);
+    std::string compressed = gzip(data);
+    BufferStream source(compressed);
+    GzipStream stream(source);
+    CHECK(stream.begin());
+
+    // Mix single reads, peeks and block reads of sizes that don't line up
+    // with the window or the input buffer
+    std::string out;
+    size_t blockSize = 1;
+    while (true)
+    {
+        int peeked = stream.peek();
+        int c = stream.read();
+        CHECK_EQUAL(peeked, c);
+        if (c < 0)
+        {
+            break;
+        }
+        out += (char)c;
+
+        std::vector<char> block(blockSize);
+        size_t length = stream.readBytes(&block[0], blockSize);
+        out.append(&block[0], length);
+        blockSize = blockSize * 3 % 5003 + 1;
+    }
+
+    CHECK_EQUAL(data.size(), out.size());
+    CHECK(out == data);
+    CHECK_EQUAL(data.size(), stream.decompressedBytes());
+    CHECK_EQUAL(compressed.size(), stream.compressedBytesRead());
+}
+
+static void testHeaderFields()
+{
+    std::string data = "{\"data\":[]}";
+    uint8_t flagSets[] = {0x02, 0x04, 0x08, 0x10, 0x1e};
+    for (uint8_t flags : flagSets)
+    {
+        BufferStream source(gzip(data, flags));
+        GzipStream stream(source);
+        CHECK(stream.begin());
+        CHECK(readAll(stream) == data);
+    }
+}
+
+static void testNotGzip()
+{
+    // e.g. a server ignoring Accept-Encoding
+    BufferStream plain("{\"title\":\"Unauthorized\",\"type\":\"about:blank\"}");
+    GzipStream plainStream(plain);
+    CHECK(!plainStream.begin());
+    CHECK_EQUAL(-1, plainStream.read());
+    CHECK_EQUAL(0, plainStream.available());
+
+    // Not deflate
+    std::string wrongMethod = gzip("hello");
+    wrongMethod[2] = 7;
+    BufferStream wrongSource(wrongMethod);
+    GzipStream wrongStream(wrongSource);
+    CHECK(!wrongStream.begin());
+
+    // Connection dropped in the header
+    BufferStream shortHeader(gzip("hello", 0x08).substr(0, 14));
+    GzipStream shortStream(shortHeader);
+    CHECK(!shortStream.begin());
+
+    BufferStream empty("");
+    GzipStream emptyStream(empty);
+    CHECK(!emptyStream.begin());
+}
+
+static void testTruncated()
+{
+    std::string data = searchResponse(3 * TWEESP32_GZIP_WINDOW_SIZE);
+    std::string compressed = gzip(data);
+    BufferStream source(compressed.substr(0, compressed.size() / 2));
+    GzipStream stream(source);
+    CHECK(stream.begin());
+
+    // Everything that made it is inflated, then the stream just ends
+    std::string out = readAll(stream);
+    CHECK(out.size() > 0);
+    CHECK(out.size() < data.size());
+    CHECK(out == data.substr(0, out.size()));
+    CHECK_EQUAL(-1, stream.read());
+    CHECK_EQUAL(-1, stream.peek());
+}
+
+static void testDoesntWaitAtTheEnd()
+{
+    // The server closes the connection after the body, so the last piece
+    // is all there will be. Waiting for more would sit out the timeout
+    std::string data = searchResponse(3000);
+    BufferStream source(gzip(data));
+    source.setTimeout(2000);
+    GzipStream stream(source);
+
+    unsigned long start = millis();
+    CHECK(stream.begin());
+    CHECK(readAll(stream) == data);
+    CHECK_EQUAL(0, millis() - start);
+}
+
+static void testCorrupt()
+{
+    std::string compressed = gzip(searchResponse(4096));
+    // 0x07 is a block type that doesn't exist
+    compressed[10] = 0x07;
+    BufferStream source(compressed);
+    GzipStream stream(source);
+    CHECK(stream.begin());
+    CHECK_EQUAL(-1, stream.read());
+    CHECK_EQUAL(0, stream.available());
+}
+
+int main()
+{
+    testSmallBody();
+    testLargerThanWindow();
+    testHeaderFields();
+    testNotGzip();
+    testTruncated();
+    testDoesntWaitAtTheEnd();
+    testCorrupt();
+    return TEST_RESULT();
+}
@@ -0,0 +1,168 @@
+#include "test.h"
+
+// searchTweets against a canned response, both as it comes and gzipped, so
+// the headers after the status line (encoding, rate limits) are read the way
+// the server sends them.
+
+#include <string>
+#include <zlib.h>
+
+#include "ScriptedClient.h"
+#include "TweESP32.h"
+
+static const char *searchBody =
+    "{\"data\":[{\"author_id\":\"2244994945\",\"id\":\"1580000000000000001\",\"text\":\"first\"},"
+    "{\"author_id\":\"2244994945\",\"id\":\"1580000000000000000\",\"text\":\"second\"}],"
+    "\"includes\":{\"users\":[{\"id\":\"2244994945\",\"name\":\"Twitter Dev\",\"username\":\"TwitterDev\"}]},"
+    "\"meta\":{\"newest_id\":\"1580000000000000001\",\"oldest_id\":\"1580000000000000000\",\"result_count\":2}}";
+
+static std::string gzip(const std::string &data)
+{
+    z_stream stream = {};
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY);
+
+    std::string out(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = (Bytef *)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef *)&out[0];
+    stream.avail_out = out.size();
+    deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return out;
+}
+
+static std::string response(const std::string &statusLine, const std::string &headers, const std::string &body)
+{
+    return statusLine + "\r\n"
+           "content-type: application/json; charset=utf-8\r\n" +
+           headers +
+           "\r\n" + body;
+}
+
+static std::string texts;
+
+static bool collectText(TweetSearchResult tweet, int index, int numResults)
+{
+    texts += std::string(tweet.text) + "/" + tweet.username + ";";
+    return true;
+}
+
+static void checkSearch(ScriptedClient &client, bool useGzip)
+{
+    TweESP32 twitter(client, "bearer");
+    twitter.useGzip = useGzip;
+
+    TweESP32Context context;
+    char query[] = "from%3Atwitterdev";
+    texts.clear();
+    unsigned long start = millis();
+    CHECK_EQUAL(2, twitter.searchTweets(context, collectText, query));
+    CHECK(millis() - start < TWEESP32_TIMEOUT);
+    CHECK_EQUAL(0, context.error.httpStatus);
+    CHECK_STRING("1580000000000000001", context.tweetId);
+    CHECK(texts == "first/TwitterDev;second/TwitterDev;");
+    CHECK_EQUAL(useGzip, client.request.find("Accept-Encoding: gzip\r\n") != std::string::npos);
+}
+
+static void testPlainResponse()
+{
+    ScriptedClient client(response("HTTP/1.1 200 OK", "", searchBody));
+    checkSearch(client, false);
+}
+
+static void testGzippedResponse()
+{
+    // The body starts with the gzip magic, nothing in it is a '{' to skip to
+    ScriptedClient client(response("HTTP/1.1 200 OK", "content-encoding: gzip\r\n", gzip(searchBody)));
+    checkSearch(client, true);
+}
+
+static void testLongStatusLine()
+{
+    // The reason phrase doesn't fit the status buffer, the headers still start on the next line
+    ScriptedClient client(response("HTTP/1.1 200 OK But With A Reason Phrase Far Longer Than Usual", "content-encoding: gzip\r\n", gzip(searchBody)));
+    checkSearch(client, true);
+}
+
+static void testRateLimitHeaders()
+{
+    bool gzipped[] = {false, true};
+    for (bool useGzip : gzipped)
+    {
+        ScriptedClient client(response("HTTP/1.1 200 OK",
+                                       "x-rate-limit-limit: 450\r\n"
+                                       "x-rate-limit-remaining: 449\r\n"
+                                       "x-rate-limit-reset: 1666000900\r\n" +
+                                           std::string(useGzip ? "content-encoding: gzip\r\n" : ""),
+                                       useGzip ? gzip(searchBody) : searchBody));
+        TweESP32 twitter(client, "bearer");
+        twitter.useGzip = useGzip;
+
+        TweESP32Context context;
+        char query[] = "from%3Atwitterdev";
+        CHECK_EQUAL(2, twitter.searchTweets(context, NULL, query));
+        CHECK_EQUAL(449, context.rateLimitRemaining);
+        CHECK_EQUAL(1666000900, context.rateLimitReset);
+        CHECK_EQUAL(0, context.error.retryAfter);
+    }
+}
+
+static void testTooManyRequests()
+{
+    hostSetEpoch(1666000000);
+    std::string body = "{\"title\":\"Too Many Requests\",\"detail\":\"Too Many Requests\",\"type\":\"about:blank\",\"status\":429}";
+
+    // Says how long to wait
+    ScriptedClient client(response("HTTP/1.1 429 Too Many Requests",
+                                   "Retry-After: 77\r\n"
+                                   "x-rate-limit-remaining: 0\r\n"
+                                   "x-rate-limit-reset: 1666000900\r\n",
+                                   body));
+    TweESP32 twitter(client, "bearer");
+    TweESP32Context context;
+    char query[] = "from%3Atwitterdev";
+    CHECK_EQUAL(-1, twitter.searchTweets(context, NULL, query));
+    CHECK_EQUAL(429, context.error.httpStatus);
+    CHECK_STRING("Too Many Requests", context.error.title);
+    CHECK(context.error.retryable);
+    CHECK_EQUAL(77, context.error.retryAfter);
+    CHECK_EQUAL(1666000900, context.error.rateLimitReset);
+    CHECK_EQUAL(0, context.rateLimitRemaining);
+    CHECK_EQUAL(1666000900, context.rateLimitReset);
+
+    // Only says when the limit resets, gzipped like the rest of the responses
+    ScriptedClient resetOnly(response("HTTP/1.1 429 Too Many Requests",
+                                      "x-rate-limit-remaining: 0\r\n"
+                                      "x-rate-limit-reset: 1666000900\r\n"
+                                      "content-encoding: gzip\r\n",
+                                      gzip(body)));
+    TweESP32 gzipTwitter(resetOnly, "bearer");
+    gzipTwitter.useGzip = true;
+    CHECK_EQUAL(-1, gzipTwitter.searchTweets(context, NULL, query));
+    CHECK_EQUAL(429, context.error.httpStatus);
+    CHECK_STRING("Too Many Requests", context.error.title);
+    CHECK_EQUAL(900, context.error.retryAfter);
+    CHECK_EQUAL(0, context.rateLimitRemaining);
+
+    // Without the clock there's no working it out, and no waiting for it either
+    hostSetEpoch(0);
+    ScriptedClient noClock(response("HTTP/1.1 429 Too Many Requests", "x-rate-limit-reset: 1666000900\r\n", body));
+    TweESP32 noClockTwitter(noClock, "bearer");
+    unsigned long start = millis();
+    CHECK_EQUAL(-1, noClockTwitter.searchTweets(context, NULL, query));
+    CHECK_EQUAL(429, context.error.httpStatus);
+    CHECK_EQUAL(0, context.error.retryAfter);
+    CHECK_EQUAL(1666000900, context.error.rateLimitReset);
+    CHECK_EQUAL(start, millis());
+}
+
+int main()
+{
+    testPlainResponse();
+    testGzippedResponse();
+    testLongStatusLine();
+    testRateLimitHeaders();
+    testTooManyRequests();
+    return TEST_RESULT();
+}
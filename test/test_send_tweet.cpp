@@ -0,0 +1,82 @@
+#include "test.h"
+
+// The body sendTweet builds for a reply and attached media, and that IDs
+// which don't fit (or aren't IDs) are turned down before connecting.
+
+#include <string>
+
+#include "ScriptedClient.h"
+#include "TweESP32.h"
+
+static const char *tweetResponse =
+    "HTTP/1.1 201 Created\r\n"
+    "content-type: application/json; charset=utf-8\r\n"
+    "\r\n"
+    "{\"data\":{\"id\":\"1580000000000000001\",\"text\":\"Hello\"}}";
+
+// Content-Length bytes from the end of the headers
+static std::string body(const std::string &request)
+{
+    size_t start = request.find("\r\n\r\n");
+    size_t lengthStart = request.find("Content-Length: ");
+    if (start == std::string::npos || lengthStart == std::string::npos)
+    {
+        return "";
+    }
+    return request.substr(start + 4, strtoul(request.c_str() + lengthStart + 16, NULL, 10));
+}
+
+static void testReplyWithMedia()
+{
+    ScriptedClient client(tweetResponse);
+    TweESP32 twitter(client, "consumerKey", "consumerSecret", "accessToken", "accessTokenSecret");
+
+    // The longest IDs that fit
+    std::string replyTo(TWEESP32_TWEET_ID_LENGTH - 1, '9');
+    std::string mediaId(TWEESP32_MEDIA_ID_LENGTH - 1, '8');
+    char message[] = "Hello";
+    CHECK(twitter.sendTweet(message, &replyTo[0], mediaId.c_str()));
+    CHECK_STRING("1580000000000000001", twitter.lastTweetId);
+
+    std::string expected = "{\"text\":\"Hello\",\"reply\":{\"in_reply_to_tweet_id\":\"" + replyTo +
+                           "\"},\"media\":{\"media_ids\":[\"" + mediaId + "\"]}}";
+    CHECK(body(client.request) == expected);
+}
+
+static void testBadIds()
+{
+    ScriptedClient client(tweetResponse);
+    TweESP32 twitter(client, "consumerKey", "consumerSecret", "accessToken", "accessTokenSecret");
+    char message[] = "Hello";
+
+    std::string tooLong(TWEESP32_TWEET_ID_LENGTH, '9');
+    CHECK(!twitter.sendTweet(message, &tooLong[0]));
+    CHECK_EQUAL(TWEESP32_INVALID_TWEET, twitter.lastError.httpStatus);
+    CHECK_STRING("Reply ID is not a tweet ID", twitter.lastError.title);
+
+    // Would break out of the JSON string
+    char quoted[] = "1\",\"quote_tweet_id\":\"2";
+    CHECK(!twitter.sendTweet(message, quoted));
+    CHECK_EQUAL(TWEESP32_INVALID_TWEET, twitter.lastError.httpStatus);
+
+    char empty[] = "";
+    CHECK(!twitter.sendTweet(message, empty));
+    CHECK_EQUAL(TWEESP32_INVALID_TWEET, twitter.lastError.httpStatus);
+
+    std::string mediaTooLong(TWEESP32_MEDIA_ID_LENGTH, '8');
+    CHECK(!twitter.sendTweet(message, NULL, mediaTooLong.c_str()));
+    CHECK_EQUAL(TWEESP32_INVALID_TWEET, twitter.lastError.httpStatus);
+    CHECK_STRING("Media ID is not a media ID", twitter.lastError.title);
+    CHECK(!twitter.lastError.retryable);
+
+    // None of them cost a request
+    CHECK_EQUAL(0, client.attempts);
+}
+
+int main()
+{
+    hostSetEpoch(1666000000);
+    testReplyWithMedia();
+    testBadIds();
+    return TEST_RESULT();
+}
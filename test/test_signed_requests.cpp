@@ -0,0 +1,186 @@
+#include "test.h"
+
+// Tasks signing requests at the same time through one TweESP32, some
+// tweeting through a client pool and some only generating headers. Every
+// header that was sent has to be exactly the one its nonce and timestamp
+// give when signed on its own, so a nonce or signature shared between tasks
+// shows up even without -DTWEESP32_SANITIZE=thread.
+
+#include <ctype.h>
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ScriptedClient.h"
+#include "TweESP32.h"
+
+#define CLIENTS 3
+#define TWEETING_TASKS 3
+#define SIGNING_TASKS 4
+#define REQUESTS_PER_TASK 1000
+
+#define TWEET_URL "https://api.twitter.com/2/tweets"
+#define SEARCH_URL "https://api.twitter.com/2/tweets/search/recent"
+
+static const char *tweetResponse =
+    "HTTP/1.1 201 Created\r\n"
+    "content-type: application/json; charset=utf-8\r\n"
+    "\r\n"
+    "{\"data\":{\"id\":\"1580000000000000001\",\"text\":\"Hello\"}}";
+
+struct SignedRequest
+{
+    std::string method;
+    std::string url;
+    std::string queryParams;
+    std::string authorization;
+    std::string nonce; // As the caller was given it, empty if it wasn't
+};
+
+static std::mutex signedLock;
+static std::vector<SignedRequest> signedRequests;
+
+static void addSigned(const SignedRequest &request)
+{
+    std::lock_guard<std::mutex> guard(signedLock);
+    signedRequests.push_back(request);
+}
+
+// Keeps the Authorization header of every request it is sent
+class TweetServer : public ScriptedClient
+{
+public:
+    TweetServer() : ScriptedClient(tweetResponse) {}
+
+    void stop()
+    {
+        if (_connected)
+        {
+            size_t start = request.find("Authorization: ");
+            size_t end = request.find("\r\n", start);
+            if (start != std::string::npos && end != std::string::npos)
+            {
+                start += strlen("Authorization: ");
+                addSigned({"POST", TWEET_URL, "", request.substr(start, end - start), ""});
+            }
+        }
+        ScriptedClient::stop();
+    }
+};
+
+// The value of name="value" in an OAuth header
+static std::string field(const std::string &header, const std::string &name)
+{
+    size_t start = header.find(name + "=\"");
+    if (start == std::string::npos)
+    {
+        return "";
+    }
+    start += name.size() + 2;
+    return header.substr(start, header.find('"', start) - start);
+}
+
+static void testConcurrentSigning()
+{
+    TweetServer unpooled;
+    TweetServer clients[CLIENTS];
+    Client *pool[CLIENTS];
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        pool[i] = &clients[i];
+    }
+    TweESP32 twitter(unpooled, "consumerKey", "consumerSecret", "accessToken", "accessTokenSecret");
+    CHECK(twitter.setClientPool(pool, CLIENTS));
+
+    std::mutex failedLock;
+    int failed = 0;
+    int sentNonceMismatch = 0;
+    std::vector<std::thread> tasks;
+    for (int t = 0; t < TWEETING_TASKS; t++)
+    {
+        tasks.emplace_back([&]() {
+            TweESP32Context context;
+            char message[] = "Hello";
+            for (int i = 0; i < REQUESTS_PER_TASK; i++)
+            {
+                bool sent = twitter.sendTweet(context, message);
+                std::lock_guard<std::mutex> guard(failedLock);
+                failed += sent && strcmp(context.tweetId, "1580000000000000001") == 0 ? 0 : 1;
+                sentNonceMismatch += field(context.auth, "oauth_nonce") == context.nonce ? 0 : 1;
+            }
+        });
+    }
+    for (int t = 0; t < SIGNING_TASKS; t++)
+    {
+        // One with a nonce buffer of its own, the rest leaving it to the library
+        bool ownNonce = t == 0;
+        tasks.emplace_back([&, t, ownNonce]() {
+            for (int i = 0; i < REQUESTS_PER_TASK; i++)
+            {
+                std::string query = "max_results=" + std::to_string(10 + t) + "&query=task" + std::to_string(i);
+                char nonce[TWEESP32_NONCE_LENGTH + 1];
+                char auth[TWEESP32_AUTH_LENGTH];
+                if (twitter.generateOAuthHeader("GET", SEARCH_URL, query.c_str(), "", auth, ownNonce ? nonce : NULL))
+                {
+                    addSigned({"GET", SEARCH_URL, query, auth, ownNonce ? nonce : ""});
+                }
+                else
+                {
+                    std::lock_guard<std::mutex> guard(failedLock);
+                    failed++;
+                }
+            }
+        });
+    }
+    for (std::thread &task : tasks)
+    {
+        task.join();
+    }
+
+    CHECK_EQUAL(0, failed);
+    CHECK_EQUAL(0, sentNonceMismatch);
+    CHECK_EQUAL(0, unpooled.connections);
+    CHECK_EQUAL((TWEETING_TASKS + SIGNING_TASKS) * REQUESTS_PER_TASK, (int)signedRequests.size());
+
+    // Signed again one at a time, each header should come out the same
+    std::set<std::string> nonces;
+    int badNonces = 0;
+    int mismatched = 0;
+    for (const SignedRequest &request : signedRequests)
+    {
+        std::string nonce = field(request.authorization, "oauth_nonce");
+        bool alphanumeric = nonce.size() == TWEESP32_NONCE_LENGTH;
+        for (char c : nonce)
+        {
+            alphanumeric = alphanumeric && isalnum((unsigned char)c);
+        }
+        if (!alphanumeric || !nonces.insert(nonce).second || (!request.nonce.empty() && request.nonce != nonce))
+        {
+            badNonces++;
+            continue;
+        }
+
+        unsigned long timestamp = strtoul(field(request.authorization, "oauth_timestamp").c_str(), NULL, 10);
+        char sig[100];
+        char expected[TWEESP32_AUTH_LENGTH];
+        if (!twitter.calculateSignature(request.method.c_str(), request.url.c_str(), timestamp, request.queryParams.c_str(), "", sig, nonce.c_str()))
+        {
+            mismatched++;
+            continue;
+        }
+        twitter.generateAuthHeader(timestamp, sig, expected, nonce.c_str());
+        mismatched += request.authorization == expected ? 0 : 1;
+    }
+    CHECK_EQUAL(0, badNonces);
+    CHECK_EQUAL(0, mismatched);
+}
+
+int main()
+{
+    hostSetEpoch(1666000000);
+    testConcurrentSigning();
+    return TEST_RESULT();
+}
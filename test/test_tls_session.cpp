@@ -0,0 +1,123 @@
+#include "test.h"
+
+// When connecting with a saved TLS session fails, the library should only
+// clear it and try a full handshake if the cache says the server rejected it.
+
+#include "ScriptedClient.h"
+#include "TweESP32.h"
+
+static const char *emptySearch =
+    "HTTP/1.1 200 OK\r\n"
+    "content-type: application/json; charset=utf-8\r\n"
+    "\r\n"
+    "{\"meta\":{\"result_count\":0}}";
+
+class TestSessionCache : public TlsSessionCache
+{
+public:
+    bool haveSession = true;
+    bool rejected = false;
+    int cleared = 0;
+    int asked = 0;
+
+    bool apply(Client &client, const char *host) { return haveSession; }
+    bool save(Client &client, const char *host) { return false; }
+    void clear(const char *host)
+    {
+        cleared++;
+        haveSession = false;
+    }
+
+    bool sessionRejected(Client &client, const char *host)
+    {
+        asked++;
+        return rejected;
+    }
+};
+
+// Doesn't override sessionRejected
+class MinimalSessionCache : public TlsSessionCache
+{
+public:
+    int cleared = 0;
+
+    bool apply(Client &client, const char *host) { return true; }
+    bool save(Client &client, const char *host) { return false; }
+    void clear(const char *host) { cleared++; }
+};
+
+static int search(TweESP32 &twitter)
+{
+    char query[] = "%23dogs";
+    return twitter.searchTweets(NULL, query, false);
+}
+
+static void testRejectedSessionRetries()
+{
+    ScriptedClient client(emptySearch);
+    client.failConnects = 1;
+    TestSessionCache cache;
+    cache.rejected = true;
+    TweESP32 twitter(client, "bearer");
+    twitter.setTlsSessionCache(&cache);
+
+    CHECK_EQUAL(0, search(twitter));
+    CHECK_EQUAL(2, client.attempts);
+    CHECK_EQUAL(1, cache.asked);
+    CHECK_EQUAL(1, cache.cleared);
+    CHECK_EQUAL(1, twitter.fullHandshakes.load());
+}
+
+static void testOtherFailuresDontRetry()
+{
+    // e.g. no WiFi, the session is still good for when it's back
+    ScriptedClient client(emptySearch);
+    client.failConnects = 1;
+    TestSessionCache cache;
+    TweESP32 twitter(client, "bearer");
+    twitter.setTlsSessionCache(&cache);
+
+    CHECK_EQUAL(-1, search(twitter));
+    CHECK_EQUAL(-1, twitter.lastError.httpStatus);
+    CHECK_EQUAL(1, client.attempts);
+    CHECK_EQUAL(1, cache.asked);
+    CHECK_EQUAL(0, cache.cleared);
+    CHECK_EQUAL(0, twitter.fullHandshakes.load());
+}
+
+static void testNoSessionNotAsked()
+{
+    ScriptedClient client(emptySearch);
+    client.failConnects = 1;
+    TestSessionCache cache;
+    cache.haveSession = false;
+    cache.rejected = true;
+    TweESP32 twitter(client, "bearer");
+    twitter.setTlsSessionCache(&cache);
+
+    CHECK_EQUAL(-1, search(twitter));
+    CHECK_EQUAL(1, client.attempts);
+    CHECK_EQUAL(0, cache.asked);
+}
+
+static void testDefaultDoesntRetry()
+{
+    ScriptedClient client(emptySearch);
+    client.failConnects = 1;
+    MinimalSessionCache cache;
+    TweESP32 twitter(client, "bearer");
+    twitter.setTlsSessionCache(&cache);
+
+    CHECK_EQUAL(-1, search(twitter));
+    CHECK_EQUAL(1, client.attempts);
+    CHECK_EQUAL(0, cache.cleared);
+}
+
+int main()
+{
+    testRejectedSessionRetries();
+    testOtherFailuresDontRetry();
+    testNoSessionNotAsked();
+    testDefaultDoesntRetry();
+    return TEST_RESULT();
+}
@@ -0,0 +1,416 @@
+#include "test.h"
+
+// Replays synthetic tweet arrivals against TweetPoller, with a stand-in for
+// TweESP32's search that serves the trace a page at a time and enforces a
+// rate limit, and the host clocks moved forward instead of sleeping.
+
+#include <string>
+#include <time.h>
+#include <vector>
+
+#include "ScriptedClient.h"
+#include "TweetPoller.h"
+
+#define START_EPOCH 1666000800 // On a 15 minute boundary
+#define MINUTE 60000UL
+#define HOUR (60 * MINUTE)
+
+// Stands in for Twitter's recent search endpoint
+struct FakeSearch
+{
+    std::vector<unsigned long> arrivals; // millis() each tweet is posted, its ID is its index + 1
+    std::vector<int> deliveries;         // How many times each tweet was returned
+
+    // Like the API's max_results=10, the rest come in later pages
+    size_t pageSize = 10;
+
+    int rateLimit = 450;
+    unsigned long windowStart = START_EPOCH;
+    int used = 0;
+
+    // Overrides the response of the next search if set, after letting
+    // nextStatusAfter searches through
+    int nextStatus = 0;
+    int nextStatusAfter = 0;
+    unsigned long nextRetryAfter = 0;
+
+    int searches = 0;
+    int rateLimited = 0;
+    std::vector<unsigned long> pollTimes; // Recorded by run(), a poll can be several searches
+    std::vector<unsigned long> latencies; // For each tweet, from being posted to being returned
+};
+
+static FakeSearch *search;
+
+// The only parts of TweESP32 the poller uses
+
+TweESP32::TweESP32(Client &client, const char *bearerToken)
+{
+    this->client = &client;
+}
+
+TweESP32::~TweESP32()
+{
+}
+
+unsigned long TweESP32::getEpoch(uint32_t wait)
+{
+    struct tm timeinfo;
+    if (!getLocalTime(&timeinfo, wait))
+    {
+        return 0;
+    }
+    return timegm(&timeinfo);
+}
+
+int TweESP32::searchTweets(TweESP32Context &context, processTweetSearch searchCallback, char *query, bool includeUsername, char *since_id, const char *paginationToken)
+{
+    context.error = TweESP32Error();
+    context.nextToken[0] = '\0';
+    unsigned long now = millis();
+    search->searches++;
+
+    if (search->nextStatus != 0 && search->nextStatusAfter > 0)
+    {
+        search->nextStatusAfter--;
+    }
+    else if (search->nextStatus != 0)
+    {
+        context.error.httpStatus = search->nextStatus;
+        context.error.retryable = search->nextStatus == 429 || search->nextStatus >= 500;
+        context.error.retryAfter = search->nextRetryAfter;
+        search->nextStatus = 0;
+        return -1;
+    }
+
+    // The real clock keeps going even if the device's isn't set
+    unsigned long epoch = START_EPOCH + now / 1000;
+    while (epoch >= search->windowStart + 900)
+    {
+        search->windowStart += 900;
+        search->used = 0;
+    }
+    context.rateLimitReset = search->windowStart + 900;
+
+    if (search->used >= search->rateLimit)
+    {
+        search->rateLimited++;
+        context.rateLimitRemaining = 0;
+        context.error.httpStatus = 429;
+        context.error.retryable = true;
+        context.error.rateLimitReset = context.rateLimitReset;
+        return -1;
+    }
+    search->used++;
+    context.rateLimitRemaining = search->rateLimit - search->used;
+
+    // Newest first, like the API. The token is the ID the last page ended at
+    size_t sinceId = since_id != NULL ? strtoul(since_id, NULL, 10) : 0;
+    size_t untilId = paginationToken != NULL ? strtoul(paginationToken, NULL, 10) : search->arrivals.size() + 1;
+    std::vector<std::string> ids;
+    for (size_t i = untilId - 1; i > sinceId; i--)
+    {
+        if (search->arrivals[i - 1] <= now)
+        {
+            ids.push_back(std::to_string(i));
+        }
+    }
+    if (ids.size() > search->pageSize)
+    {
+        ids.resize(search->pageSize);
+        strcpy(context.nextToken, ids.back().c_str());
+    }
+
+    context.tweetId[0] = '\0';
+    if (!ids.empty())
+    {
+        strcpy(context.tweetId, ids[0].c_str());
+    }
+
+    int resultCount = ids.size();
+    for (int i = 0; i < resultCount; i++)
+    {
+        size_t index = strtoul(ids[i].c_str(), NULL, 10) - 1;
+        search->deliveries[index]++;
+        search->latencies[index] = now - search->arrivals[index];
+
+        TweetSearchResult tweet = {};
+        tweet.tweetId = ids[i].c_str();
+        tweet.text = "woof";
+        searchCallback(tweet, i, resultCount);
+    }
+
+    return resultCount;
+}
+
+static bool ignoreTweet(TweetSearchResult tweet, int index, int numResults)
+{
+    return true;
+}
+
+static void addArrivals(FakeSearch &trace, unsigned long start, unsigned long end, unsigned long every)
+{
+    for (unsigned long time = start; time < end; time += every)
+    {
+        trace.arrivals.push_back(time);
+    }
+    trace.deliveries.resize(trace.arrivals.size());
+    trace.latencies.resize(trace.arrivals.size());
+}
+
+// Polls whenever it's due until the end of the trace, sleeping in between
+static void run(TweetPoller &poller, unsigned long end, std::vector<unsigned long> *intervals = NULL)
+{
+    char query[] = "%23dogs";
+    while (millis() < end)
+    {
+        if (poller.isDue())
+        {
+            search->pollTimes.push_back(millis());
+            poller.poll(ignoreTweet, query);
+            if (intervals != NULL)
+            {
+                intervals->push_back(poller.interval);
+            }
+        }
+        hostAdvanceMillis(poller.timeUntilNextPoll() > 0 ? poller.timeUntilNextPoll() : 1);
+    }
+}
+
+static void startClock(bool clockSet)
+{
+    hostSetMillis(0);
+    hostSetEpoch(clockSet ? START_EPOCH : 0);
+}
+
+static void testBurstyTrace()
+{
+    // Quiet for 2 hours, a tweet every 5s for 20 minutes, one every
+    // 10 minutes for an hour, then quiet again
+    FakeSearch trace;
+    addArrivals(trace, 2 * HOUR, 2 * HOUR + 20 * MINUTE, 5000);
+    size_t burstEnd = trace.arrivals.size();
+    addArrivals(trace, 2 * HOUR + 20 * MINUTE, 3 * HOUR + 20 * MINUTE, 10 * MINUTE);
+    search = &trace;
+
+    startClock(true);
+    ScriptedClient client;
+    TweESP32 twitter(client, "bearer");
+    TweetPoller poller(twitter, 30000, 900000);
+
+    std::vector<unsigned long> intervals;
+    run(poller, 6 * HOUR, &intervals);
+
+    // Every tweet turned up exactly once, though the start of the burst
+    // took more than a page
+    for (size_t i = 0; i < trace.arrivals.size(); i++)
+    {
+        CHECK_EQUAL(1, trace.deliveries[i]);
+    }
+    CHECK(trace.searches > (int)trace.pollTimes.size());
+
+    for (unsigned long interval : intervals)
+    {
+        CHECK(interval >= poller.minInterval && interval <= poller.maxInterval);
+    }
+
+    // Backed off to the max while quiet at the start, each poll doubling it
+    CHECK_EQUAL(60000, intervals[0]);
+    CHECK_EQUAL(900000, intervals[4]);
+    CHECK(trace.pollTimes[5] < 2 * HOUR);
+    CHECK_EQUAL(900000, intervals[5]);
+
+    // Sped up to the min once the burst started (900s halved 5 times)
+    size_t firstBurstPoll = 0;
+    while (trace.pollTimes[firstBurstPoll] < 2 * HOUR)
+    {
+        firstBurstPoll++;
+    }
+    CHECK_EQUAL(30000, intervals[firstBurstPoll + 4]);
+    CHECK(trace.pollTimes[firstBurstPoll + 4] < 2 * HOUR + 20 * MINUTE);
+
+    // From then on tweets were picked up within the min interval
+    size_t checked = 0;
+    for (size_t i = 0; i < burstEnd; i++)
+    {
+        if (trace.arrivals[i] >= trace.pollTimes[firstBurstPoll + 4])
+        {
+            CHECK(trace.latencies[i] <= 30000);
+            checked++;
+        }
+    }
+    CHECK(checked > 20);
+
+    // Far fewer requests than polling every 30s (720)
+    CHECK(trace.searches < 200);
+    CHECK_EQUAL(0, trace.rateLimited);
+
+    // Back at the max by the end
+    CHECK_EQUAL(900000, intervals.back());
+}
+
+static int deliveredOnce(FakeSearch &trace, size_t from, size_t to)
+{
+    int once = 0;
+    for (size_t i = from; i < to; i++)
+    {
+        once += trace.deliveries[i] == 1 ? 1 : 0;
+    }
+    return once;
+}
+
+static void testBurstBiggerThanAPage()
+{
+    // 35 tweets between two polls, more than fit in one page
+    FakeSearch trace;
+    addArrivals(trace, 1000, 36000, 1000);
+    search = &trace;
+
+    startClock(true);
+    ScriptedClient client;
+    TweESP32 twitter(client, "bearer");
+    TweetPoller poller(twitter, 30000, 900000);
+    char query[] = "%23dogs";
+
+    CHECK_EQUAL(0, poller.poll(ignoreTweet, query));
+    hostAdvanceMillis(60000);
+    CHECK_EQUAL(35, poller.poll(ignoreTweet, query));
+    CHECK_EQUAL(1 + 4, trace.searches);
+    CHECK_EQUAL(35, deliveredOnce(trace, 0, 35));
+    CHECK_EQUAL(30000, poller.interval);
+
+    // Pages past the limit are left for the next poll, which finishes the
+    // burst before moving on to tweets that arrived since
+    poller.maxPagesPerPoll = 2;
+    addArrivals(trace, 70000, 95000, 1000);
+    hostAdvanceMillis(60000);
+    CHECK_EQUAL(20, poller.poll(ignoreTweet, query));
+    addArrivals(trace, 125000, 128000, 1000);
+    hostAdvanceMillis(60000);
+    CHECK_EQUAL(5, poller.poll(ignoreTweet, query));
+    CHECK_EQUAL(25, deliveredOnce(trace, 35, 60));
+    hostAdvanceMillis(60000);
+    CHECK_EQUAL(3, poller.poll(ignoreTweet, query));
+    CHECK_EQUAL(28, deliveredOnce(trace, 35, 63));
+
+    // A page that fails is tried again by the next poll
+    addArrivals(trace, 250000, 265000, 1000);
+    hostAdvanceMillis(60000);
+    trace.nextStatus = 503;
+    trace.nextStatusAfter = 1;
+    CHECK_EQUAL(-1, poller.poll(ignoreTweet, query));
+    CHECK_EQUAL(10, deliveredOnce(trace, 63, 78));
+    hostAdvanceMillis(poller.timeUntilNextPoll());
+    CHECK_EQUAL(5, poller.poll(ignoreTweet, query));
+    CHECK_EQUAL(15, deliveredOnce(trace, 63, 78));
+
+    // Unless it would keep failing, then the rest are skipped rather than
+    // getting stuck on them
+    addArrivals(trace, 400000, 415000, 1000);
+    hostAdvanceMillis(poller.timeUntilNextPoll() + 60000);
+    trace.nextStatus = 400;
+    trace.nextStatusAfter = 1;
+    CHECK_EQUAL(-1, poller.poll(ignoreTweet, query));
+    CHECK_EQUAL(10, deliveredOnce(trace, 78, 93));
+    addArrivals(trace, millis() + 1, millis() + 2, 1);
+    hostAdvanceMillis(poller.timeUntilNextPoll());
+    CHECK_EQUAL(1, poller.poll(ignoreTweet, query));
+    CHECK_EQUAL(1, trace.deliveries[93]);
+    CHECK_EQUAL(10, deliveredOnce(trace, 78, 93));
+}
+
+static void testSpreadsOutRateLimit()
+{
+    // A tweet every 6s would keep it polling at the 5s min, 180 times every
+    // 15 minutes, but only 20 requests are allowed. Those can return up to
+    // 200 tweets, enough for the 150 that turn up
+    FakeSearch trace;
+    trace.rateLimit = 20;
+    addArrivals(trace, 0, 2 * HOUR, 6000);
+    search = &trace;
+
+    startClock(true);
+    ScriptedClient client;
+    TweESP32 twitter(client, "bearer");
+    TweetPoller poller(twitter, 5000, 900000);
+    run(poller, 2 * HOUR);
+
+    CHECK_EQUAL(0, trace.rateLimited);
+
+    // Still used most of what it's allowed, 8 windows of 20
+    CHECK(trace.searches >= 8 * 18);
+    CHECK(trace.searches <= 8 * 20 + 1);
+
+    // Apart from those posted after the last poll
+    for (size_t i = 0; i < trace.arrivals.size(); i++)
+    {
+        CHECK_EQUAL(trace.arrivals[i] <= trace.pollTimes.back() ? 1 : 0, trace.deliveries[i]);
+    }
+}
+
+static void testNeedsClockForRateLimit()
+{
+    // Without timeConfig the poller can't tell when the limit resets,
+    // so it just polls as fast as it's allowed to and runs out
+    FakeSearch trace;
+    trace.rateLimit = 20;
+    addArrivals(trace, 0, 30 * MINUTE, 2000);
+    search = &trace;
+
+    startClock(false);
+    ScriptedClient client;
+    TweESP32 twitter(client, "bearer");
+    TweetPoller poller(twitter, 5000, 900000);
+    run(poller, 15 * MINUTE);
+
+    CHECK(trace.rateLimited > 0);
+
+    // Finding the clock isn't set doesn't hold up the poll
+    char query[] = "%23dogs";
+    unsigned long before = millis();
+    poller.poll(ignoreTweet, query);
+    CHECK_EQUAL(before, millis());
+}
+
+static void testErrors()
+{
+    FakeSearch trace;
+    search = &trace;
+
+    startClock(true);
+    ScriptedClient client;
+    TweESP32 twitter(client, "bearer");
+    TweetPoller poller(twitter, 30000, 900000);
+    char query[] = "%23dogs";
+
+    // Waits at least as long as asked to
+    trace.nextStatus = 429;
+    trace.nextRetryAfter = 300;
+    CHECK_EQUAL(-1, poller.poll(ignoreTweet, query));
+    CHECK_EQUAL(300000, poller.interval);
+    CHECK(!poller.isDue());
+    CHECK_EQUAL(300000, poller.timeUntilNextPoll());
+
+    // Server errors back off like an empty result
+    hostAdvanceMillis(poller.timeUntilNextPoll());
+    trace.nextStatus = 503;
+    CHECK_EQUAL(-1, poller.poll(ignoreTweet, query));
+    CHECK_EQUAL(600000, poller.interval);
+
+    // Retrying won't fix a bad token, so wait as long as possible
+    hostAdvanceMillis(poller.timeUntilNextPoll());
+    poller.interval = 30000;
+    trace.nextStatus = 401;
+    CHECK_EQUAL(-1, poller.poll(ignoreTweet, query));
+    CHECK_EQUAL(900000, poller.interval);
+}
+
+int main()
+{
+    testBurstyTrace();
+    testBurstBiggerThanAPage();
+    testSpreadsOutRateLimit();
+    testNeedsClockForRateLimit();
+    testErrors();
+    return TEST_RESULT();
+}
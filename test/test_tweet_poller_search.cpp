@@ -0,0 +1,228 @@
+#include "test.h"
+
+// TweetPoller on top of the real searchTweets, against a stand-in for the
+// recent search endpoint that serves a trace of tweets ten at a time and
+// sends the rate limit headers. test_tweet_poller replaces searchTweets
+// entirely, so this is what checks the paging and rate limit fields make it
+// through the HTTP response.
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ScriptedClient.h"
+#include "TweetPoller.h"
+
+#define START_EPOCH 1666000800 // On a 15 minute boundary
+#define FIRST_ID 1580000000000000000ULL
+
+class SearchServer : public ScriptedClient
+{
+public:
+    std::vector<unsigned long> arrivals; // millis() each tweet is posted, its ID is FIRST_ID + its index
+    int rateLimit = 450;
+    int searches = 0;
+    int rateLimited = 0;
+
+    void addArrivals(unsigned long start, unsigned long end, unsigned long every)
+    {
+        for (unsigned long time = start; time < end; time += every)
+        {
+            arrivals.push_back(time);
+        }
+    }
+
+protected:
+    void received()
+    {
+        if (request.find("\r\n\r\n") == std::string::npos)
+        {
+            return;
+        }
+        searches++;
+
+        std::string path = request.substr(4, request.find(" HTTP/1.0") - 4);
+        size_t sinceIndex = parameter(path, "since_id", FIRST_ID - 1) - FIRST_ID + 1;
+        size_t untilIndex = parameter(path, "pagination_token", FIRST_ID + arrivals.size()) - FIRST_ID;
+        size_t maxResults = parameter(path, "max_results", 10);
+
+        unsigned long epoch = START_EPOCH + millis() / 1000;
+        while (epoch >= _windowStart + 900)
+        {
+            _windowStart += 900;
+            _used = 0;
+        }
+        std::string rateLimitHeaders = "x-rate-limit-reset: " + std::to_string(_windowStart + 900) + "\r\n";
+
+        if (_used >= rateLimit)
+        {
+            rateLimited++;
+            respond("429 Too Many Requests", rateLimitHeaders + "x-rate-limit-remaining: 0\r\n",
+                    "{\"title\":\"Too Many Requests\",\"detail\":\"Too Many Requests\",\"type\":\"about:blank\",\"status\":429}");
+            return;
+        }
+        _used++;
+        rateLimitHeaders += "x-rate-limit-remaining: " + std::to_string(rateLimit - _used) + "\r\n";
+
+        // Newest first, the token is the ID the last page ended at
+        std::vector<std::string> ids;
+        for (size_t i = untilIndex; i > sinceIndex; i--)
+        {
+            if (arrivals[i - 1] <= millis())
+            {
+                ids.push_back(std::to_string(FIRST_ID + i - 1));
+            }
+        }
+        std::string nextToken;
+        if (ids.size() > maxResults)
+        {
+            ids.resize(maxResults);
+            nextToken = ids.back();
+        }
+
+        std::string body = "{";
+        if (!ids.empty())
+        {
+            body += "\"data\":[";
+            for (size_t i = 0; i < ids.size(); i++)
+            {
+                body += std::string(i == 0 ? "" : ",") + "{\"author_id\":\"2244994945\",\"id\":\"" + ids[i] + "\",\"text\":\"woof\"}";
+            }
+            body += "],\"includes\":{\"users\":[{\"id\":\"2244994945\",\"name\":\"Twitter Dev\",\"username\":\"TwitterDev\"}]},";
+        }
+        body += "\"meta\":{";
+        if (!ids.empty())
+        {
+            body += "\"newest_id\":\"" + ids.front() + "\",\"oldest_id\":\"" + ids.back() + "\",";
+        }
+        if (!nextToken.empty())
+        {
+            body += "\"next_token\":\"" + nextToken + "\",";
+        }
+        body += "\"result_count\":" + std::to_string(ids.size()) + "}}";
+        respond("200 OK", rateLimitHeaders, body);
+    }
+
+private:
+    unsigned long _windowStart = START_EPOCH;
+    int _used = 0;
+
+    static unsigned long long parameter(const std::string &path, const std::string &name, unsigned long long fallback)
+    {
+        size_t start = path.find("&" + name + "=");
+        if (start == std::string::npos)
+        {
+            start = path.find("?" + name + "=");
+        }
+        if (start == std::string::npos)
+        {
+            return fallback;
+        }
+        return strtoull(path.c_str() + start + name.size() + 2, NULL, 10);
+    }
+
+    void respond(const std::string &status, const std::string &headers, const std::string &body)
+    {
+        reply("HTTP/1.1 " + status + "\r\n"
+              "content-type: application/json; charset=utf-8\r\n" +
+              headers +
+              "\r\n" + body);
+    }
+};
+
+static std::map<unsigned long long, int> deliveries;
+
+static bool countTweet(TweetSearchResult tweet, int index, int numResults)
+{
+    deliveries[strtoull(tweet.tweetId, NULL, 10)]++;
+    return true;
+}
+
+static int deliveredOnce(SearchServer &server)
+{
+    int once = 0;
+    for (size_t i = 0; i < server.arrivals.size(); i++)
+    {
+        auto found = deliveries.find(FIRST_ID + i);
+        once += found != deliveries.end() && found->second == 1 ? 1 : 0;
+    }
+    return once;
+}
+
+static void startClock()
+{
+    hostSetMillis(0);
+    hostSetEpoch(START_EPOCH);
+    deliveries.clear();
+}
+
+static void testBurstBiggerThanAPage()
+{
+    startClock();
+    SearchServer server;
+    server.addArrivals(1000, 36000, 1000);
+    TweESP32 twitter(server, "bearer");
+    TweetPoller poller(twitter, 30000, 900000);
+    char query[] = "%23dogs";
+
+    CHECK_EQUAL(0, poller.poll(countTweet, query));
+    CHECK_EQUAL(449, poller.context.rateLimitRemaining);
+    CHECK_EQUAL(START_EPOCH + 900, poller.context.rateLimitReset);
+
+    hostAdvanceMillis(60000);
+    CHECK_EQUAL(35, poller.poll(countTweet, query));
+    CHECK_EQUAL(1 + 4, server.searches);
+    CHECK_EQUAL(35, deliveredOnce(server));
+    CHECK(server.request.find("&pagination_token=1580000000000000005") != std::string::npos);
+    CHECK_EQUAL(445, poller.context.rateLimitRemaining);
+
+    // Moved on past the whole burst
+    server.addArrivals(100000, 101000, 1000);
+    hostAdvanceMillis(poller.timeUntilNextPoll() + 60000);
+    CHECK_EQUAL(1, poller.poll(countTweet, query));
+    CHECK(server.request.find("&since_id=1580000000000000034") != std::string::npos);
+    CHECK_EQUAL(36, deliveredOnce(server));
+}
+
+static void testSpreadsOutRateLimit()
+{
+    // A tweet every 6s would keep it polling at the 5s min, but only 20
+    // requests are allowed every 15 minutes. Spacing them out relies on the
+    // rate limit headers being read
+    startClock();
+    SearchServer server;
+    server.rateLimit = 20;
+    server.addArrivals(0, 3600000, 6000);
+    TweESP32 twitter(server, "bearer");
+    TweetPoller poller(twitter, 5000, 900000);
+    char query[] = "%23dogs";
+
+    unsigned long lastPoll = 0;
+    while (millis() < 3600000)
+    {
+        if (poller.isDue())
+        {
+            lastPoll = millis();
+            poller.poll(countTweet, query);
+        }
+        hostAdvanceMillis(poller.timeUntilNextPoll() > 0 ? poller.timeUntilNextPoll() : 1);
+    }
+
+    CHECK_EQUAL(0, server.rateLimited);
+    CHECK(server.searches >= 4 * 18);
+    CHECK(server.searches <= 4 * 20 + 1);
+
+    int expected = 0;
+    for (unsigned long arrival : server.arrivals)
+    {
+        expected += arrival <= lastPoll ? 1 : 0;
+    }
+    CHECK_EQUAL(expected, deliveredOnce(server));
+}
+
+int main()
+{
+    testBurstBiggerThanAPage();
+    testSpreadsOutRateLimit();
+    return TEST_RESULT();
+}
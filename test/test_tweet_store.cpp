@@ -0,0 +1,173 @@
+#include "test.h"
+
+#include <string>
+
+#include "TweetStore.h"
+
+static TweetSearchResult makeTweet(int number, const char *username, const char *text = NULL)
+{
+    static std::string ids[64];
+    static std::string texts[64];
+    ids[number % 64] = std::to_string(number);
+    texts[number % 64] = text != NULL ? text : "Tweet number " + std::to_string(number);
+
+    TweetSearchResult tweet = {};
+    tweet.tweetId = ids[number % 64].c_str();
+    tweet.text = texts[number % 64].c_str();
+    tweet.authorId = username;
+    tweet.name = username;
+    tweet.username = username;
+    tweet.likeCount = number;
+    return tweet;
+}
+
+static void testNewestFirst()
+{
+    TweetStore store(3, 1024);
+    CHECK_EQUAL(0, store.count());
+    CHECK(store.get(0).tweetId == NULL);
+
+    for (int i = 1; i <= 5; i++)
+    {
+        CHECK(store.add(makeTweet(i, "alice")) != 0);
+    }
+
+    // Only the newest 3 are kept
+    CHECK_EQUAL(3, store.count());
+    CHECK_STRING("5", store.get(0).tweetId);
+    CHECK_STRING("4", store.get(1).tweetId);
+    CHECK_STRING("3", store.get(2).tweetId);
+    CHECK_EQUAL(5, store.get(0).likeCount);
+    CHECK(store.get(3).tweetId == NULL);
+    CHECK(store.get(-1).tweetId == NULL);
+}
+
+static void testFieldsThatWereNotRequested()
+{
+    TweetStore store(2, 256);
+    TweetSearchResult tweet = makeTweet(1, "alice");
+    tweet.name = NULL;
+    tweet.username = NULL;
+    store.add(tweet);
+
+    TweetSearchResult stored = store.get(0);
+    CHECK(stored.name == NULL);
+    CHECK(stored.username == NULL);
+    CHECK(stored.createdAt == NULL);
+    CHECK(stored.conversationId == NULL);
+    CHECK_STRING("Tweet number 1", stored.text);
+}
+
+static void testInterning()
+{
+    TweetStore sameUser(10, 2048);
+    TweetStore differentUsers(10, 2048);
+    std::string names[10];
+    for (int i = 0; i < 10; i++)
+    {
+        names[i] = "user_with_a_long_name_" + std::to_string(i);
+        sameUser.add(makeTweet(i, "user_with_a_long_name_0"));
+        differentUsers.add(makeTweet(i, names[i].c_str()));
+    }
+
+    // The author ID, name and username are stored once for all 10 tweets
+    size_t nameBytes = strlen("user_with_a_long_name_0") + 1;
+    CHECK_EQUAL(differentUsers.poolUsed() - 9 * 3 * nameBytes, sameUser.poolUsed());
+    CHECK(sameUser.get(0).username == sameUser.get(9).username);
+    CHECK_STRING("user_with_a_long_name_0", sameUser.get(9).username);
+}
+
+static void testDroppingToMakeRoom()
+{
+    // Room for about 3 of these tweets
+    std::string longText(60, 'x');
+    TweetStore store(10, 256);
+    for (int i = 0; i < 20; i++)
+    {
+        longText[0] = 'a' + i;
+        CHECK(store.add(makeTweet(i, i % 2 ? "bob" : "alice", longText.c_str())) != 0);
+        CHECK(store.poolUsed() <= 256);
+
+        // Everything that's left is intact after the pool is compacted
+        for (int j = 0; j < store.count(); j++)
+        {
+            TweetSearchResult tweet = store.get(j);
+            std::string id = std::to_string(i - j);
+            CHECK_STRING(id.c_str(), tweet.tweetId);
+            CHECK_STRING((i - j) % 2 ? "bob" : "alice", tweet.username);
+            CHECK_EQUAL('a' + i - j, tweet.text[0]);
+            CHECK_EQUAL(60, strlen(tweet.text));
+        }
+    }
+    CHECK(store.count() < 10);
+    CHECK(store.count() >= 2);
+
+    // Interned strings survive the tweet that first stored them being dropped
+    TweetStore interned(3, 512);
+    for (int i = 0; i < 12; i++)
+    {
+        interned.add(makeTweet(i, "carol"));
+        CHECK_STRING("carol", interned.get(interned.count() - 1).username);
+    }
+}
+
+static void testTooBig()
+{
+    TweetStore store(4, 64);
+    std::string longText(100, 'x');
+    CHECK(store.add(makeTweet(1, "alice", longText.c_str())) == 0);
+    CHECK_EQUAL(0, store.count());
+
+    // A store that couldn't allocate its memory doesn't store anything
+    TweetStore empty(0, 0);
+    CHECK(empty.add(makeTweet(1, "alice")) == 0);
+    CHECK_EQUAL(0, empty.count());
+}
+
+static void testHandles()
+{
+    std::string longText(60, 'x');
+    TweetStore store(10, 256);
+
+    longText[0] = 'a';
+    TweetHandle first = store.add(makeTweet(1, "alice", longText.c_str()));
+    longText[0] = 'b';
+    TweetHandle second = store.add(makeTweet(2, "bob", longText.c_str()));
+    CHECK(first != 0);
+    CHECK(second != first);
+    CHECK_EQUAL(second, store.handle(0));
+    CHECK_EQUAL(first, store.handle(1));
+    CHECK_EQUAL(0, store.handle(2));
+
+    // Adding more moves the text, a handle still finds the same tweet
+    longText[0] = 'c';
+    store.add(makeTweet(3, "carol", longText.c_str()));
+    longText[0] = 'd';
+    store.add(makeTweet(4, "dave", longText.c_str()));
+    CHECK(!store.contains(first));
+    CHECK(store.find(first).tweetId == NULL);
+    CHECK(store.contains(second));
+    CHECK_STRING("2", store.find(second).tweetId);
+    CHECK_EQUAL('b', store.find(second).text[0]);
+    CHECK_STRING("bob", store.find(second).username);
+
+    // Handles aren't reused after clear()
+    store.clear();
+    CHECK_EQUAL(0, store.count());
+    CHECK_EQUAL(0, store.poolUsed());
+    CHECK(!store.contains(second));
+    TweetHandle afterClear = store.add(makeTweet(5, "erin"));
+    CHECK(afterClear != first && afterClear != second);
+    CHECK(!store.contains(0));
+}
+
+int main()
+{
+    testNewestFirst();
+    testFieldsThatWereNotRequested();
+    testInterning();
+    testDroppingToMakeRoom();
+    testTooBig();
+    testHandles();
+    return TEST_RESULT();
+}
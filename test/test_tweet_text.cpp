@@ -0,0 +1,181 @@
+#include "test.h"
+
+#include <string>
+
+#include "TweetText.h"
+
+#define GRINNING "\xF0\x9F\x98\x80"              // U+1F600
+#define THUMBS_UP_MEDIUM "\xF0\x9F\x91\x8D\xF0\x9F\x8F\xBD" // U+1F44D U+1F3FD
+#define FAMILY "\xF0\x9F\x91\xA8\xE2\x80\x8D\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA7" // man ZWJ woman ZWJ girl
+#define FLAG_GB "\xF0\x9F\x87\xAC\xF0\x9F\x87\xA7"
+#define RED_HEART "\xE2\x9D\xA4\xEF\xB8\x8F"    // U+2764 U+FE0F
+#define KANJI "\xE8\xAA\x9E"                     // U+8A9E
+
+static std::string repeat(const char *text, int times)
+{
+    std::string result;
+    for (int i = 0; i < times; i++)
+    {
+        result += text;
+    }
+    return result;
+}
+
+static void testWeightedLength()
+{
+    CHECK_EQUAL(0, tweetWeightedLength(""));
+    CHECK_EQUAL(11, tweetWeightedLength("Hello World"));
+    CHECK_EQUAL(5, tweetWeightedLength("caf\xC3\xA9!"));      // Latin-1 counts as 1
+    CHECK_EQUAL(6, tweetWeightedLength("\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82")); // Cyrillic, 6 letters
+    CHECK_EQUAL(6, tweetWeightedLength(KANJI KANJI KANJI));
+    CHECK_EQUAL(1, tweetWeightedLength("\xE2\x80\x94"));      // em dash is in a light range
+    CHECK_EQUAL(2, tweetWeightedLength("\xE2\x82\xAC"));      // euro sign isn't
+}
+
+static void testEmoji()
+{
+    CHECK_EQUAL(2, tweetWeightedLength(GRINNING));
+    CHECK_EQUAL(2, tweetWeightedLength(THUMBS_UP_MEDIUM));
+    CHECK_EQUAL(2, tweetWeightedLength(FAMILY));
+    CHECK_EQUAL(2, tweetWeightedLength(FLAG_GB));
+    CHECK_EQUAL(4, tweetWeightedLength(FLAG_GB FLAG_GB));
+    CHECK_EQUAL(2, tweetWeightedLength(RED_HEART));
+    CHECK_EQUAL(6, tweetWeightedLength("a" FAMILY "b" GRINNING));
+
+    // A skin tone on its own is still an emoji
+    CHECK_EQUAL(2, tweetWeightedLength("\xF0\x9F\x8F\xBD"));
+}
+
+static void testLinks()
+{
+    CHECK_EQUAL(23, tweetWeightedLength("https://example.com"));
+    CHECK_EQUAL(23, tweetWeightedLength("http://example.com/a/very/long/path/that/is/longer/than/23?query=1"));
+    CHECK_EQUAL(23, tweetWeightedLength("HTTPS://EXAMPLE.COM"));
+    CHECK_EQUAL(4 + 23, tweetWeightedLength("see https://example.com/abc"));
+
+    // Punctuation at the end of a sentence isn't part of the link
+    CHECK_EQUAL(4 + 23 + 1, tweetWeightedLength("see https://example.com/abc."));
+    CHECK_EQUAL(1 + 23 + 1, tweetWeightedLength("(https://example.com)"));
+
+    // Only at the start of a word
+    CHECK_EQUAL(20, tweetWeightedLength("xhttps://example.com"));
+
+    // A link ends at the first non ASCII character
+    CHECK_EQUAL(23 + 2, tweetWeightedLength("https://example.com" KANJI));
+}
+
+static void testInvalidUtf8()
+{
+    CHECK_EQUAL(-1, tweetWeightedLength("\xC0\xAF"));         // overlong
+    CHECK_EQUAL(-1, tweetWeightedLength("\xE0\x80\xAF"));     // overlong
+    CHECK_EQUAL(-1, tweetWeightedLength("\xED\xA0\x80"));     // surrogate
+    CHECK_EQUAL(-1, tweetWeightedLength("\xF4\x90\x80\x80")); // past U+10FFFF
+    CHECK_EQUAL(-1, tweetWeightedLength("abc\xE8\xAA"));      // cut off
+    CHECK_EQUAL(-1, tweetWeightedLength("\x80"));             // stray continuation
+    CHECK_EQUAL(-1, tweetWeightedLength("\xFF"));
+}
+
+static void testFitLength()
+{
+    CHECK_EQUAL(11, tweetFitLength("Hello World"));
+    CHECK_EQUAL(5, tweetFitLength("Hello World", 5));
+    CHECK_EQUAL(7, tweetFitLength("Hello World", 7));
+    CHECK_EQUAL(5, tweetFitLength("Hello World", 7, TWEESP32_MAX_TWEET_BYTES, true));
+
+    // A word too long for a tweet is cut where it has to be
+    CHECK_EQUAL(4, tweetFitLength("abcdefgh", 4, TWEESP32_MAX_TWEET_BYTES, true));
+
+    // Characters are never split
+    CHECK_EQUAL(6, tweetFitLength(KANJI KANJI KANJI, 5));
+    CHECK_EQUAL(6, tweetFitLength(KANJI KANJI KANJI, 280, 8));
+
+    // Emoji sequences are never split, even when the bytes run out part way through
+    std::string families = FAMILY FAMILY;
+    CHECK_EQUAL(18, tweetFitLength(families.c_str(), 280, 30));
+    CHECK_EQUAL(0, tweetFitLength(FAMILY, 280, 10));
+    CHECK_EQUAL(8, tweetFitLength(FLAG_GB FLAG_GB, 3));
+
+    // Links are never split
+    CHECK_EQUAL(3, tweetFitLength("ab https://example.com", 20));
+
+    // The byte budget is for the JSON escaped text
+    CHECK_EQUAL(3, tweetFitLength("ab\"\"", 280, 4));
+    CHECK_EQUAL(1, tweetFitLength("a\nb", 280, 2));
+
+    // Stops before invalid UTF-8
+    CHECK_EQUAL(3, tweetFitLength("abc\xFF" "def"));
+
+    // 140 of the 8 byte emoji fit
+    std::string thumbs = repeat(THUMBS_UP_MEDIUM, 150);
+    CHECK_EQUAL(140 * 8, tweetFitLength(thumbs.c_str()));
+}
+
+static void testParts()
+{
+    CHECK_EQUAL(0, tweetPartCount(""));
+    CHECK_EQUAL(0, tweetPartCount("  \n "));
+    CHECK_EQUAL(1, tweetPartCount("Hello World"));
+    CHECK_EQUAL(-1, tweetPartCount("abc\xFF"));
+
+    std::string words = repeat("word ", 100); // 500 characters
+    CHECK_EQUAL(2, tweetPartCount(words.c_str()));
+
+    std::string kanji = repeat(KANJI, 300);
+    CHECK_EQUAL(3, tweetPartCount(kanji.c_str()));
+
+    // A link that can never fit
+    std::string longLink = "https://" + std::string(2000, 'a');
+    CHECK_EQUAL(-1, tweetPartCount(longLink.c_str()));
+
+    // Parts skip the spaces between them and don't split words
+    const char *text = "  one two three";
+    size_t length;
+    const char *part = nextTweetPart(text, length, 9);
+    CHECK(part == text + 2);
+    CHECK_EQUAL(7, length);
+    part = nextTweetPart(part + length, length, 9);
+    CHECK_EQUAL(5, length);
+    CHECK(strncmp(part, "three", 5) == 0);
+    CHECK(nextTweetPart(part + length, length, 9) == NULL);
+
+    // Every part of a long mixed message fits
+    std::string report = repeat("Temp 21.5\xC2\xB0" "C " KANJI KANJI " " THUMBS_UP_MEDIUM " https://example.com/s/1\n", 40);
+    const char *remaining = report.c_str();
+    int parts = 0;
+    while ((part = nextTweetPart(remaining, length)) != NULL)
+    {
+        std::string text(part, length);
+        CHECK(length > 0);
+        CHECK(tweetWeightedLength(text.c_str()) <= TWEESP32_MAX_TWEET_WEIGHT);
+        CHECK(tweetJsonLength(part, length) <= TWEESP32_MAX_TWEET_BYTES);
+        remaining = part + length;
+        parts++;
+    }
+    CHECK_EQUAL(tweetPartCount(report.c_str()), parts);
+}
+
+static void testJsonEscape()
+{
+    const char *text = "say \"hi\"\\\n\t\x01";
+    char out[64];
+    size_t written = tweetJsonEscape(out, text, strlen(text));
+    CHECK_STRING("say \\\"hi\\\"\\\\\\n\\t\\u0001", out);
+    CHECK_EQUAL(strlen(out), written);
+    CHECK_EQUAL(written, tweetJsonLength(text, strlen(text)));
+
+    // UTF-8 is passed through as it is
+    written = tweetJsonEscape(out, KANJI, 3);
+    CHECK_STRING(KANJI, out);
+}
+
+int main()
+{
+    testWeightedLength();
+    testEmoji();
+    testLinks();
+    testInvalidUtf8();
+    testFitLength();
+    testParts();
+    testJsonEscape();
+    return TEST_RESULT();
+}
@@ -0,0 +1,264 @@
+#include "test.h"
+
+// uploadMedia against a stand-in for upload.twitter.com, checking what is
+// sent for each step (INIT, APPEND per segment, FINALIZE) and how failures
+// are reported.
+
+#include <string>
+#include <vector>
+
+#include "ScriptedClient.h"
+#include "TweESP32.h"
+
+// Serves a fixed buffer as the media
+class MediaStream : public Stream
+{
+public:
+    MediaStream(const std::string &data) : _data(data) {}
+
+    int available() { return _data.size() - _position; }
+    int read() { return _position < _data.size() ? (uint8_t)_data[_position++] : -1; }
+    int peek() { return _position < _data.size() ? (uint8_t)_data[_position] : -1; }
+    size_t write(uint8_t c) { return 0; }
+
+private:
+    std::string _data;
+    size_t _position = 0;
+};
+
+// Records each request and answers it once it has all arrived, going by
+// the command in the body like the real endpoint
+class UploadServer : public ScriptedClient
+{
+public:
+    struct Request
+    {
+        std::string host;
+        std::string headers;
+        std::string body;
+    };
+    std::vector<Request> requests;
+
+    // Status to answer APPEND with, e.g. to fail one
+    int appendStatus = 204;
+
+    int connect(const char *host, uint16_t port)
+    {
+        requests.push_back(Request());
+        requests.back().host = host;
+        _answered = false;
+        return ScriptedClient::connect(host, port);
+    }
+
+protected:
+    void received()
+    {
+        size_t headersEnd = request.find("\r\n\r\n");
+        if (headersEnd == std::string::npos || _answered)
+        {
+            return;
+        }
+
+        std::string headers = request.substr(0, headersEnd);
+        size_t lengthStart = headers.find("Content-Length: ");
+        if (lengthStart == std::string::npos)
+        {
+            return;
+        }
+        size_t contentLength = strtoul(headers.c_str() + lengthStart + 16, NULL, 10);
+        std::string body = request.substr(headersEnd + 4);
+        if (body.size() < contentLength)
+        {
+            return;
+        }
+
+        requests.back().headers = headers;
+        requests.back().body = body;
+        _answered = true;
+
+        if (body.find("command=INIT") == 0)
+        {
+            respond("202 Accepted", "{\"media_id\":710511363345354753,\"media_id_string\":\"710511363345354753\",\"expires_after_secs\":86400}");
+        }
+        else if (body.find("name=\"command\"\r\n\r\nAPPEND") != std::string::npos)
+        {
+            if (appendStatus == 204)
+            {
+                respond("204 No Content", "");
+            }
+            else
+            {
+                respond(std::to_string(appendStatus) + " Bad Request", "{\"errors\":[{\"code\":324,\"message\":\"Invalid media\"}]}");
+            }
+        }
+        else if (body.find("command=FINALIZE") == 0)
+        {
+            respond("201 Created", "{\"media_id\":710511363345354753,\"media_id_string\":\"710511363345354753\",\"size\":11065}");
+        }
+        else
+        {
+            respond("400 Bad Request", "{\"errors\":[{\"code\":38,\"message\":\"command parameter is missing.\"}]}");
+        }
+    }
+
+private:
+    bool _answered = false;
+
+    void respond(const std::string &status, const std::string &body)
+    {
+        reply("HTTP/1.1 " + status + "\r\n"
+              "content-type: application/json;charset=utf-8\r\n"
+              "content-length: " + std::to_string(body.size()) + "\r\n"
+              "\r\n" + body);
+    }
+};
+
+static std::string mediaData(size_t length)
+{
+    std::string data;
+    for (size_t i = 0; i < length; i++)
+    {
+        data += (char)(i * 7 + i / 251);
+    }
+    return data;
+}
+
+static std::string header(const std::string &headers, const char *name)
+{
+    size_t start = headers.find(std::string(name) + ": ");
+    if (start == std::string::npos)
+    {
+        return "";
+    }
+    start += strlen(name) + 2;
+    return headers.substr(start, headers.find("\r\n", start) - start);
+}
+
+static void testUpload()
+{
+    hostSetEpoch(1666000000);
+    UploadServer server;
+    TweESP32 twitter(server, "consumerKey", "consumerSecret", "accessToken", "accessTokenSecret");
+    twitter.uploadHost = "localhost";
+    twitter.mediaSegmentSize = 4000;
+
+    // Segments of 4000, 4000 and 2000
+    std::string data = mediaData(10000);
+    MediaStream media(data);
+    char mediaId[TWEESP32_TWEET_ID_LENGTH] = "";
+    CHECK(twitter.uploadMedia(media, data.size(), "image/png", mediaId));
+    CHECK_STRING("710511363345354753", mediaId);
+    CHECK_EQUAL(0, twitter.lastError.httpStatus);
+
+    CHECK_EQUAL(5, server.requests.size());
+    if (server.requests.size() != 5)
+    {
+        return;
+    }
+
+    for (UploadServer::Request &request : server.requests)
+    {
+        CHECK_STRING("localhost", request.host.c_str());
+        CHECK(request.headers.find("POST /1.1/media/upload.json HTTP/1.0\r\n") == 0);
+        CHECK(header(request.headers, "Host") == "localhost");
+        CHECK(header(request.headers, "Authorization").find("OAuth ") == 0);
+        CHECK_EQUAL(request.body.size(), strtoul(header(request.headers, "Content-Length").c_str(), NULL, 10));
+    }
+
+    CHECK_STRING("command=INIT&media_type=image%2Fpng&total_bytes=10000", server.requests[0].body.c_str());
+    CHECK(header(server.requests[0].headers, "Content-Type") == "application/x-www-form-urlencoded");
+
+    // The media arrives intact, split into numbered segments
+    std::string received;
+    for (int segment = 0; segment < 3; segment++)
+    {
+        const std::string &body = server.requests[1 + segment].body;
+        CHECK(header(server.requests[1 + segment].headers, "Content-Type").find("multipart/form-data; boundary=") == 0);
+        CHECK(body.find("name=\"media_id\"\r\n\r\n710511363345354753\r\n") != std::string::npos);
+        CHECK(body.find("name=\"segment_index\"\r\n\r\n" + std::to_string(segment) + "\r\n") != std::string::npos);
+
+        size_t mediaStart = body.find("Content-Type: application/octet-stream\r\n\r\n") + 42;
+        size_t mediaEnd = body.rfind("\r\n--");
+        received += body.substr(mediaStart, mediaEnd - mediaStart);
+    }
+    CHECK_EQUAL(data.size(), received.size());
+    CHECK(received == data);
+
+    CHECK_STRING("command=FINALIZE&media_id=710511363345354753", server.requests[4].body.c_str());
+}
+
+static void testFailedAppend()
+{
+    UploadServer server;
+    server.appendStatus = 400;
+    TweESP32 twitter(server, "consumerKey", "consumerSecret", "accessToken", "accessTokenSecret");
+    twitter.uploadHost = "localhost";
+
+    std::string data = mediaData(100);
+    MediaStream media(data);
+    char mediaId[TWEESP32_TWEET_ID_LENGTH] = "";
+    CHECK(!twitter.uploadMedia(media, data.size(), "image/png", mediaId));
+
+    // Stopped at the APPEND, with the server's error
+    CHECK_EQUAL(2, server.requests.size());
+    CHECK_EQUAL(400, twitter.lastError.httpStatus);
+    CHECK_EQUAL(324, twitter.lastError.code);
+    CHECK_STRING("Invalid media", twitter.lastError.title);
+}
+
+static void testMediaEndsEarly()
+{
+    UploadServer server;
+    TweESP32 twitter(server, "consumerKey", "consumerSecret", "accessToken", "accessTokenSecret");
+    twitter.uploadHost = "localhost";
+
+    // Says 1000 bytes, only has 600
+    std::string data = mediaData(600);
+    MediaStream media(data);
+    char mediaId[TWEESP32_TWEET_ID_LENGTH] = "";
+    CHECK(!twitter.uploadMedia(media, 1000, "image/png", mediaId));
+
+    CHECK_EQUAL(TWEESP32_MEDIA_READ_FAILED, twitter.lastError.httpStatus);
+    CHECK(!twitter.lastError.retryable);
+    CHECK_EQUAL(2, server.requests.size());
+}
+
+static void testMediaTypeLength()
+{
+    hostSetEpoch(1666000000);
+    UploadServer server;
+    TweESP32 twitter(server, "consumerKey", "consumerSecret", "accessToken", "accessTokenSecret");
+    twitter.uploadHost = "localhost";
+    std::string data = mediaData(100);
+    char mediaId[TWEESP32_TWEET_ID_LENGTH] = "";
+
+    // The longest that fits, every character url encoded
+    std::string longest(TWEESP32_MEDIA_TYPE_LENGTH - 1, '/');
+    MediaStream media(data);
+    CHECK(twitter.uploadMedia(media, data.size(), longest.c_str(), mediaId));
+    std::string encoded;
+    for (size_t i = 0; i < longest.size(); i++)
+    {
+        encoded += "%2F";
+    }
+    CHECK(server.requests[0].body == "command=INIT&media_type=" + encoded + "&total_bytes=100");
+
+    // Turned down without connecting
+    std::string tooLong(TWEESP32_MEDIA_TYPE_LENGTH, 'a');
+    MediaStream again(data);
+    CHECK(!twitter.uploadMedia(again, data.size(), tooLong.c_str(), mediaId));
+    CHECK_EQUAL(TWEESP32_INVALID_MEDIA_TYPE, twitter.lastError.httpStatus);
+    CHECK(!twitter.lastError.retryable);
+    CHECK(!twitter.uploadMedia(again, data.size(), "", mediaId));
+    CHECK_EQUAL(TWEESP32_INVALID_MEDIA_TYPE, twitter.lastError.httpStatus);
+    CHECK_EQUAL(3, server.requests.size());
+}
+
+int main()
+{
+    testUpload();
+    testFailedAppend();
+    testMediaEndsEarly();
+    testMediaTypeLength();
+    return TEST_RESULT();
+}